@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+/**
+ * Bounded lock-free queue for any number of producers and consumers, after
+ * Dmitry Vyukov's array-based MPMC queue.
+ *
+ * Every cell carries a sequence number telling whether it is ready for the
+ * producer or the consumer of a given position, so a push or pop is one
+ * compare-and-swap on the position plus a release store on the cell.
+ * Neither side ever blocks the other; a full or empty queue is reported to
+ * the caller, who decides how to wait.
+ */
+template<class T>
+class BoundedQueue
+{
+
+private:
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	// Keeps the two positions on separate cache lines:
+	static const size_t CACHE_LINE = 64;
+
+	std::unique_ptr<Cell[]> mCells;
+	size_t mMask;
+	char mPadding0[CACHE_LINE];
+	std::atomic<size_t> mEnqueuePosition{ 0 };
+	char mPadding1[CACHE_LINE];
+	std::atomic<size_t> mDequeuePosition{ 0 };
+	char mPadding2[CACHE_LINE];
+
+public:
+
+	/**
+	 * `capacity` must be a power of two.
+	 */
+	explicit BoundedQueue(size_t capacity)
+		: mCells(new Cell[capacity]),
+		mMask(capacity - 1)
+	{
+		for (size_t i = 0; i < capacity; i++) {
+			mCells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	BoundedQueue(const BoundedQueue &) = delete;
+
+	BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+	/**
+	 * Returns false if the queue is full.
+	 */
+	bool tryPush(const T &value) {
+		size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+		while (true) {
+			Cell &cell = mCells[position & mMask];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+			if (difference == 0) {
+				if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					cell.value = value;
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				position = mEnqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+	 * Returns false if the queue is empty.
+	 */
+	bool tryPop(T &value) {
+		size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+		while (true) {
+			Cell &cell = mCells[position & mMask];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+			if (difference == 0) {
+				if (mDequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					value = cell.value;
+					cell.sequence.store(position + mMask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				position = mDequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+};
+
+/**
+ * Waits a little for another thread, e.g. on a full or empty queue, yielding
+ * first and sleeping once the wait gets long. `spins` counts the calls of
+ * one wait and starts at 0.
+ */
+inline void backoff(int &spins)
+{
+	if (++spins < 64) {
+		std::this_thread::yield();
+	}
+	else {
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+}
@@ -0,0 +1,157 @@
+#include "CellEncoder.h"
+#include <vector>
+
+namespace {
+
+/**
+ * Decimal digits of 0 to 255, so color sequences need no formatting.
+ */
+struct Decimals
+{
+	char digits[256][4];
+	std::uint8_t lengths[256];
+
+	Decimals() {
+		for (int i = 0; i < 256; i++) {
+			int length = i >= 100 ? 3 : i >= 10 ? 2 : 1;
+			for (int d = length - 1, value = i; d >= 0; d--, value /= 10) {
+				digits[i][d] = static_cast<char>('0' + value % 10);
+			}
+			lengths[i] = static_cast<std::uint8_t>(length);
+		}
+	}
+};
+
+const Decimals DECIMALS;
+
+inline bool operator==(const Rgb &a, const Rgb &b)
+{
+	return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+/**
+ * Tracks the colors set on the terminal, and appends SGR sequences only
+ * for changes.
+ */
+class ColorState
+{
+
+private:
+
+	std::string &mOut;
+	Rgb mForeground{ 0, 0, 0 };
+	Rgb mBackground{ 0, 0, 0 };
+	bool mForegroundSet = false;
+	bool mBackgroundSet = false;
+
+	void appendColor(char layer, const Rgb &color) {
+		mOut.append("\x1b[", 2);
+		mOut.push_back(layer);
+		mOut.append("8;2;", 4);
+		mOut.append(DECIMALS.digits[color.r], DECIMALS.lengths[color.r]);
+		mOut.push_back(';');
+		mOut.append(DECIMALS.digits[color.g], DECIMALS.lengths[color.g]);
+		mOut.push_back(';');
+		mOut.append(DECIMALS.digits[color.b], DECIMALS.lengths[color.b]);
+		mOut.push_back('m');
+	}
+
+public:
+
+	explicit ColorState(std::string &out)
+		: mOut(out)
+	{
+	}
+
+	~ColorState() {
+		mOut.append("\x1b[0m", 4);
+	}
+
+	void foreground(const Rgb &color) {
+		if (!mForegroundSet || !(mForeground == color)) {
+			appendColor('3', color);
+			mForeground = color;
+			mForegroundSet = true;
+		}
+	}
+
+	void background(const Rgb &color) {
+		if (!mBackgroundSet || !(mBackground == color)) {
+			appendColor('4', color);
+			mBackground = color;
+			mBackgroundSet = true;
+		}
+	}
+
+};
+
+// Dot bits of the left and right column of a Braille cell, top to bottom:
+const std::uint8_t LEFT_DOTS[4] = { 0x01, 0x02, 0x04, 0x40 };
+const std::uint8_t RIGHT_DOTS[4] = { 0x08, 0x10, 0x20, 0x80 };
+
+}
+
+void cells::encodeHalfBlocks(const Rgb *top, const Rgb *bottom, int width, std::string &out)
+{
+	ColorState state(out);
+	for (int x = 0; x < width; x++) {
+		if (top[x] == bottom[x]) {
+			state.background(top[x]);
+			out.push_back(' ');
+		}
+		else {
+			state.foreground(top[x]);
+			state.background(bottom[x]);
+			// U+2580 UPPER HALF BLOCK:
+			out.append("\xe2\x96\x80", 3);
+		}
+	}
+}
+
+void cells::encodeBraille(const Rgb *const colors[4], const std::uint8_t *const inside[4], int width, Rgb insideColor,
+	std::string &out)
+{
+	thread_local std::vector<std::uint8_t> dots;
+	dots.assign(width, 0);
+
+	// Branch-free packing of the 8 inside flags of each cell, which the compiler vectorizes:
+	for (int row = 0; row < 4; row++) {
+		const std::uint8_t *in = inside[row];
+		const std::uint8_t left = LEFT_DOTS[row];
+		const std::uint8_t right = RIGHT_DOTS[row];
+		for (int x = 0; x < width; x++) {
+			dots[x] |= static_cast<std::uint8_t>(in[2 * x] * left | in[2 * x + 1] * right);
+		}
+	}
+
+	ColorState state(out);
+	for (int x = 0; x < width; x++) {
+		// Mean color of the escaped pixels:
+		int r = 0, g = 0, b = 0, escaped = 0;
+		for (int row = 0; row < 4; row++) {
+			for (int i = 2 * x; i < 2 * x + 2; i++) {
+				if (!inside[row][i]) {
+					r += colors[row][i].r;
+					g += colors[row][i].g;
+					b += colors[row][i].b;
+					escaped++;
+				}
+			}
+		}
+		Rgb background = escaped > 0
+			? Rgb{ static_cast<std::uint8_t>(r / escaped), static_cast<std::uint8_t>(g / escaped), static_cast<std::uint8_t>(b / escaped) }
+			: insideColor;
+		state.background(background);
+
+		std::uint8_t bits = dots[x];
+		if (bits == 0) {
+			out.push_back(' ');
+			continue;
+		}
+		state.foreground(insideColor);
+		// U+2800 + bits, in UTF-8:
+		out.push_back('\xe2');
+		out.push_back(static_cast<char>(0xa0 | bits >> 6));
+		out.push_back(static_cast<char>(0x80 | (bits & 0x3f)));
+	}
+}
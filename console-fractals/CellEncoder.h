@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "Palette.h"
+
+/**
+ * Encodes several pixels per terminal cell as UTF-8 with 24-bit color
+ * escape sequences.
+ *
+ * Half blocks show two pixels per cell: the upper one as the foreground of
+ * U+2580, the lower one as the background. Braille patterns show 2x4 dots
+ * per cell, one per pixel inside the set, over the mean color of the
+ * cell's escaped pixels. Color sequences are only sent when a color
+ * changes from the previous cell.
+ */
+namespace cells {
+
+/**
+ * Appends one row of `width` cells from the two pixel rows they cover.
+ */
+void encodeHalfBlocks(const Rgb *top, const Rgb *bottom, int width, std::string &out);
+
+/**
+ * Appends one row of `width` cells from the four pixel rows they cover,
+ * each 2 * width pixels wide. `inside` holds 1 for pixels inside the set
+ * and 0 for escaped ones.
+ */
+void encodeBraille(const Rgb *const colors[4], const std::uint8_t *const inside[4], int width, Rgb insideColor,
+	std::string &out);
+
+}
@@ -0,0 +1,346 @@
+#include "DiskCache.h"
+#include <algorithm>
+#include <cstring>
+#include "Hash.h"
+#include "TileCache.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const std::uint64_t MAGIC = 0x31454843414346ull; // "FCACHE1"
+static const std::uint64_t VERSION = 1;
+
+// Smallest cache file, and ring bytes per index slot:
+static const size_t MIN_BYTES = 1 << 20;
+static const size_t BYTES_PER_SLOT = 16 << 10;
+static const std::uint64_t MIN_SLOTS = 1024;
+
+// Slots tried for a key before the oldest of them is replaced:
+static const int MAX_PROBES = 8;
+
+static_assert(sizeof(std::atomic<std::uint64_t>) == sizeof(std::uint64_t), "Atomics in the mapping must be plain words");
+
+struct DiskCache::Header
+{
+	std::uint64_t magic;
+	std::uint64_t version;
+	std::uint64_t slots;
+	std::uint64_t ringBytes;
+	// Ring position of the next entry, growing forever:
+	std::atomic<std::uint64_t> cursor;
+	std::uint64_t reserved[3];
+};
+
+struct DiskCache::Slot
+{
+	std::atomic<std::uint64_t> key;
+	// Ring position of the entry plus one, 0 if none:
+	std::atomic<std::uint64_t> position;
+};
+
+/**
+ * Precedes the channels of a G-buffer in the ring.
+ */
+struct DiskCache::Entry
+{
+	std::uint64_t key;
+	std::uint64_t position;
+	std::uint64_t pixels;
+	std::uint32_t channels;
+	std::uint32_t unused;
+	std::uint64_t checksum;
+};
+
+/**
+ * Calls `visit(data, bytes)` for each channel of `gbuffer` it has, in the
+ * order they are stored in.
+ */
+template<class G, class Visit>
+static void forChannels(G &gbuffer, Visit &&visit)
+{
+	visit(gbuffer.iterations.data(), gbuffer.iterations.size() * sizeof(int));
+	visit(gbuffer.smooth.data(), gbuffer.smooth.size() * sizeof(float));
+	visit(gbuffer.magnitude.data(), gbuffer.magnitude.size() * sizeof(float));
+	visit(gbuffer.distance.data(), gbuffer.distance.size() * sizeof(float));
+	visit(gbuffer.trap.data(), gbuffer.trap.size() * sizeof(float));
+}
+
+/**
+ * FNV-1a over the 32-bit words of every channel, as all channels have
+ * 32-bit values.
+ */
+static std::uint64_t checksum(const GBuffer &gbuffer)
+{
+	std::uint64_t hash = FNV_OFFSET;
+	forChannels(gbuffer, [&hash](const void *data, size_t bytes) {
+		const unsigned char *p = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i + 4 <= bytes; i += 4) {
+			std::uint32_t word;
+			std::memcpy(&word, p + i, 4);
+			hash = (hash ^ word) * FNV_PRIME;
+		}
+	});
+	return hash;
+}
+
+static size_t payloadBytes(const GBuffer &gbuffer)
+{
+	size_t bytes = 0;
+	forChannels(gbuffer, [&bytes](const void *, size_t channel) {
+		bytes += channel;
+	});
+	return bytes;
+}
+
+DiskCache::~DiskCache()
+{
+#ifndef _WIN32
+	if (mMapping) {
+		munmap(mMapping, mMappingSize);
+	}
+#endif
+}
+
+bool DiskCache::open(const std::string &path, size_t bytes, std::string &error)
+{
+#ifdef _WIN32
+	(void)path;
+	(void)bytes;
+	error = "the disk cache needs a POSIX system";
+	return false;
+#else
+	if (!std::atomic<std::uint64_t>().is_lock_free()) {
+		error = "64-bit atomics are not lock-free on this system";
+		return false;
+	}
+
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		error = path + ": " + std::strerror(errno);
+		return false;
+	}
+	// Only creation is serialized, so no two processes initialize the file:
+	flock(fd, LOCK_EX);
+
+	auto fail = [&](const std::string &message) {
+		if (mMapping) {
+			munmap(mMapping, mMappingSize);
+			mMapping = nullptr;
+		}
+		flock(fd, LOCK_UN);
+		::close(fd);
+		error = path + ": " + message;
+		return false;
+	};
+
+	struct stat status;
+	if (fstat(fd, &status) != 0) {
+		return fail(std::strerror(errno));
+	}
+	const bool created = status.st_size == 0;
+	if (created) {
+		if (bytes < MIN_BYTES) {
+			return fail("a disk cache needs at least 1 MiB");
+		}
+		if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+			return fail(std::strerror(errno));
+		}
+	}
+	mMappingSize = created ? bytes : static_cast<size_t>(status.st_size);
+	if (mMappingSize < sizeof(Header)) {
+		return fail("not a disk cache");
+	}
+
+	void *mapping = mmap(nullptr, mMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mapping == MAP_FAILED) {
+		return fail(std::strerror(errno));
+	}
+	mMapping = mapping;
+	mHeader = static_cast<Header *>(mMapping);
+
+	if (created) {
+		// The new file reads as zeros: an empty index and cursor.
+		std::uint64_t slots = MIN_SLOTS;
+		while (slots * BYTES_PER_SLOT < mMappingSize) {
+			slots *= 2;
+		}
+		mHeader->slots = slots;
+		mHeader->ringBytes = (mMappingSize - sizeof(Header) - slots * sizeof(Slot)) / 8 * 8;
+		mHeader->version = VERSION;
+		mHeader->magic = MAGIC;
+		msync(mMapping, sizeof(Header), MS_SYNC);
+	}
+	else if (mHeader->magic != MAGIC || mHeader->version != VERSION) {
+		return fail("not a disk cache of this version");
+	}
+	else {
+		// The probes mask with slots - 1, and the index and ring must fit the file:
+		const std::uint64_t slots = mHeader->slots;
+		const std::uint64_t ring = mHeader->ringBytes;
+		const std::uint64_t space = mMappingSize - sizeof(Header);
+		if (slots < MIN_SLOTS || (slots & (slots - 1)) != 0 || slots > space / sizeof(Slot)
+			|| ring == 0 || ring % 8 != 0 || ring > space - slots * sizeof(Slot)) {
+			return fail("corrupt disk cache");
+		}
+	}
+
+	mSlots = reinterpret_cast<Slot *>(static_cast<unsigned char *>(mMapping) + sizeof(Header));
+	mRing = reinterpret_cast<unsigned char *>(mSlots + mHeader->slots);
+
+	flock(fd, LOCK_UN);
+	// The mapping stays valid without the descriptor:
+	::close(fd);
+	return true;
+#endif
+}
+
+std::uint64_t DiskCache::key(const RenderRequest &request)
+{
+	std::uint64_t hash = TileCache::fingerprint(request);
+	mix(hash, request.params.maxIterations);
+	mix(hash, request.width);
+	mix(hash, request.height);
+	mix(hash, request.center.x);
+	mix(hash, request.center.y);
+	mix(hash, request.zoom);
+	mix(hash, request.channels | CHANNEL_ITERATIONS);
+
+	// FNV mixes the low bits poorly, and they pick the slot:
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	// Key 0 marks empty slots:
+	return hash != 0 ? hash : 1;
+}
+
+void DiskCache::copyIn(std::uint64_t position, const void *data, size_t count)
+{
+	if (count == 0) {
+		return;
+	}
+	const size_t ring = mHeader->ringBytes;
+	const size_t offset = position % ring;
+	const size_t first = std::min(count, ring - offset);
+	std::memcpy(mRing + offset, data, first);
+	std::memcpy(mRing, static_cast<const unsigned char *>(data) + first, count - first);
+}
+
+void DiskCache::copyOut(std::uint64_t position, void *data, size_t count) const
+{
+	if (count == 0) {
+		return;
+	}
+	const size_t ring = mHeader->ringBytes;
+	const size_t offset = position % ring;
+	const size_t first = std::min(count, ring - offset);
+	std::memcpy(data, mRing + offset, first);
+	std::memcpy(static_cast<unsigned char *>(data) + first, mRing, count - first);
+}
+
+bool DiskCache::retained(std::uint64_t position, size_t count) const
+{
+	// Overwritten once an entry has been reserved a whole ring further on:
+	const std::uint64_t cursor = mHeader->cursor.load(std::memory_order_acquire);
+	return position + count <= cursor && cursor <= position + mHeader->ringBytes;
+}
+
+bool DiskCache::load(const RenderRequest &request, GBuffer &out)
+{
+	if (!mMapping) {
+		return false;
+	}
+
+	const std::uint64_t key = DiskCache::key(request);
+	const std::uint64_t mask = mHeader->slots - 1;
+	const std::uint64_t pixels = static_cast<std::uint64_t>(request.width) * request.height;
+	const unsigned channels = request.channels | CHANNEL_ITERATIONS;
+
+	for (int probe = 0; probe < MAX_PROBES; probe++) {
+		Slot &slot = mSlots[(key + probe) & mask];
+		if (slot.key.load(std::memory_order_acquire) != key) {
+			continue;
+		}
+		const std::uint64_t stored = slot.position.load(std::memory_order_acquire);
+		if (stored == 0 || !retained(stored - 1, sizeof(Entry))) {
+			break;
+		}
+		const std::uint64_t position = stored - 1;
+
+		Entry entry;
+		copyOut(position, &entry, sizeof(Entry));
+		if (entry.key != key || entry.position != position || entry.pixels != pixels || entry.channels != channels) {
+			break;
+		}
+		out.resize(pixels, channels);
+		const size_t size = sizeof(Entry) + payloadBytes(out);
+		if (!retained(position, size)) {
+			break;
+		}
+		std::uint64_t offset = position + sizeof(Entry);
+		forChannels(out, [&](void *data, size_t bytes) {
+			copyOut(offset, data, bytes);
+			offset += bytes;
+		});
+
+		// Valid only if no writer reached the entry while it was copied:
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (!retained(position, size) || checksum(out) != entry.checksum) {
+			break;
+		}
+		mHits++;
+		return true;
+	}
+	mMisses++;
+	return false;
+}
+
+void DiskCache::store(const RenderRequest &request, const GBuffer &gbuffer)
+{
+	if (!mMapping) {
+		return;
+	}
+
+	const size_t size = (sizeof(Entry) + payloadBytes(gbuffer) + 7) / 8 * 8;
+	if (size > mHeader->ringBytes / 2) {
+		return;
+	}
+
+	// Reserve the space, write the entry and only then publish it in the index:
+	const std::uint64_t position = mHeader->cursor.fetch_add(size, std::memory_order_acq_rel);
+	Entry entry{ key(request), position, gbuffer.size, gbuffer.channels, 0, checksum(gbuffer) };
+	copyIn(position, &entry, sizeof(Entry));
+	std::uint64_t offset = position + sizeof(Entry);
+	forChannels(gbuffer, [&](const void *data, size_t bytes) {
+		copyIn(offset, data, bytes);
+		offset += bytes;
+	});
+	mStores++;
+
+	const std::uint64_t mask = mHeader->slots - 1;
+	Slot *oldest = nullptr;
+	for (int probe = 0; probe < MAX_PROBES; probe++) {
+		Slot &slot = mSlots[(entry.key + probe) & mask];
+		std::uint64_t current = slot.key.load(std::memory_order_acquire);
+		if (current == 0 && slot.key.compare_exchange_strong(current, entry.key, std::memory_order_acq_rel)) {
+			current = entry.key;
+		}
+		if (current == entry.key) {
+			slot.position.store(position + 1, std::memory_order_release);
+			return;
+		}
+		if (!oldest || slot.position.load(std::memory_order_relaxed) < oldest->position.load(std::memory_order_relaxed)) {
+			oldest = &slot;
+		}
+	}
+
+	// A reader may briefly pair the new key with the old position, which
+	// the entry's own key then rejects:
+	oldest->key.store(entry.key, std::memory_order_release);
+	oldest->position.store(position + 1, std::memory_order_release);
+}
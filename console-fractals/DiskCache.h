@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "GBuffer.h"
+#include "Renderer.h"
+
+/**
+ * Keeps the G-buffers of whole renders in a file, addressed by a hash of
+ * everything the render depends on, so a view rendered before, by this or
+ * any other process on the host, is read back instead of computed.
+ *
+ * The file is mapped into every process using it and holds a header, an
+ * index and a ring of entries. Entries are appended at a cursor which only
+ * grows, so new entries overwrite the oldest ones once the ring is full
+ * and the file never grows past its size. The index is an open-addressed
+ * table of (key, position) slots, which processes claim and update with
+ * atomic operations, so nobody ever waits for a lock.
+ *
+ * A reader cannot stop a writer overwriting the entry it reads, so every
+ * read is checked afterwards: the entry must still be in the ring, must
+ * carry the key and position looked up, and its contents must match its
+ * checksum. An entry failing any of these, e.g. one a crashed process
+ * half wrote, is a miss.
+ *
+ * Only available on POSIX systems; elsewhere open() fails.
+ */
+class DiskCache
+{
+
+public:
+
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t stores = 0;
+	};
+
+private:
+
+	struct Header;
+	struct Slot;
+	struct Entry;
+
+	// The mapping and its parts:
+	void *mMapping = nullptr;
+	size_t mMappingSize = 0;
+	Header *mHeader = nullptr;
+	Slot *mSlots = nullptr;
+	unsigned char *mRing = nullptr;
+
+	std::atomic<size_t> mHits{ 0 };
+	std::atomic<size_t> mMisses{ 0 };
+	std::atomic<size_t> mStores{ 0 };
+
+	/**
+	 * Copies `count` bytes into or out of the ring at position `position`,
+	 * wrapping around its end.
+	 */
+	void copyIn(std::uint64_t position, const void *data, size_t count);
+	void copyOut(std::uint64_t position, void *data, size_t count) const;
+
+	/**
+	 * Whether the `count` bytes from `position` on are still in the ring.
+	 */
+	bool retained(std::uint64_t position, size_t count) const;
+
+public:
+
+	DiskCache() = default;
+
+	~DiskCache();
+
+	DiskCache(const DiskCache &) = delete;
+
+	DiskCache &operator=(const DiskCache &) = delete;
+
+	/**
+	 * Maps the cache in file `path`, creating it with a size of `bytes` if it
+	 * does not exist. An existing cache keeps the size it was created with.
+	 * Returns false with a message in `error` if the file cannot be used.
+	 */
+	bool open(const std::string &path, size_t bytes, std::string &error);
+
+	/**
+	 * Hash of everything the G-buffer of `request` depends on: the formula,
+	 * the parameters and iteration cap, the precision, the kernel variant,
+	 * the view and the channels.
+	 */
+	static std::uint64_t key(const RenderRequest &request);
+
+	/**
+	 * Reads the G-buffer of `request` into `out` if the cache has it.
+	 */
+	bool load(const RenderRequest &request, GBuffer &out);
+
+	/**
+	 * Stores `gbuffer`, the render of `request`. G-buffers larger than half
+	 * the ring are not stored.
+	 */
+	void store(const RenderRequest &request, const GBuffer &gbuffer);
+
+	inline bool isOpen() const {
+		return mMapping != nullptr;
+	}
+
+	/**
+	 * Hits, misses and stores of this process.
+	 */
+	inline Stats stats() const {
+		return { mHits, mMisses, mStores };
+	}
+
+};
@@ -1,6 +1,8 @@
 #include "Display.h"
-
-const double Display::LOGIC_VIEWPORT_SIZE_MUL = 2;
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "CellEncoder.h"
 
 Display::Display()
 {
@@ -11,21 +13,556 @@ Display::~Display()
 {
 }
 
-void Display::draw()
+void Display::render()
 {
-	// Render into buffer:
+	const int width = mViewportSize.width;
+	const int height = mViewportSize.height;
+	mOrigin = { 0, 0 };
+
+	std::vector<std::uint8_t> cached = loadCached({ { 0, 0, width, height } });
+	if (cached.empty()) {
+		mRowX.resize(width);
+		mRowY.resize(width);
+		for (int x = 0; x < width; x++) {
+			mRowX[x] = shaderX(x);
+		}
+
+		// Render into the G-buffer, a whole row per kernel call:
+		for (int y = 0; y < height; y++) {
+			size_t row = static_cast<size_t>(y) * width;
+			std::fill(mRowY.begin(), mRowY.end(), shaderY(y));
+			mKernel(mRowX.data(), mRowY.data(), width, mGBuffer.span(row));
+		}
+	}
+	else {
+		// The pixels the cache lacks, with one kernel call:
+		std::vector<size_t> missing;
+		for (size_t p = 0; p < cached.size(); p++) {
+			if (!cached[p]) {
+				missing.push_back(p);
+			}
+		}
+		mScratch.resize(missing.size(), mGBuffer.channels);
+		mRowX.resize(missing.size());
+		mRowY.resize(missing.size());
+		for (size_t k = 0; k < missing.size(); k++) {
+			mRowX[k] = shaderX(static_cast<double>(missing[k] % width));
+			mRowY[k] = shaderY(static_cast<double>(missing[k] / width));
+		}
+		mKernel(mRowX.data(), mRowY.data(), static_cast<int>(missing.size()), mScratch.span());
+		for (size_t k = 0; k < missing.size(); k++) {
+			mGBuffer.copyPixel(missing[k], mScratch, k);
+		}
+	}
+
+	// Before antialiasing, which replaces the samples of edge pixels:
+	storeCached({});
+
+	if (mAntialias) {
+		antialias();
+	}
+}
+
+std::unique_ptr<RenderJob> Display::renderAsync(ThreadPool &pool, std::chrono::steady_clock::time_point deadline,
+	std::vector<RenderJob::Tile> tiles, std::vector<std::uint8_t> skip)
+{
+	if (tiles.empty()) {
+		tiles = RenderJob::tiles(mViewportSize.width, mViewportSize.height, mCenterOut);
+	}
+
+	std::vector<double> columnX(mViewportSize.width);
+	std::vector<double> rowY(mViewportSize.height);
 	for (int x = 0; x < mViewportSize.width; x++) {
-		for (int y = 0; y < mViewportSize.height; y++) {
-			double shaderX = (static_cast<double>(x) - mViewportOrigin.x) / mViewportSize.width * 2 * LOGIC_VIEWPORT_SIZE_MUL;
-			double shaderY = ((mViewportSize.height - static_cast<double>(y)) - mViewportOrigin.y) / mViewportSize.height * 2 * LOGIC_VIEWPORT_SIZE_MUL;
-			char c = mShader(shaderX, shaderY);
-			mBuffer[y][x] = c;
+		columnX[x] = shaderX(x);
+	}
+	for (int y = 0; y < mViewportSize.height; y++) {
+		rowY[y] = shaderY(y);
+	}
+
+	std::vector<std::uint8_t> cached = loadCached(tiles);
+	if (!cached.empty()) {
+		if (skip.empty()) {
+			skip.swap(cached);
 		}
+		else {
+			for (size_t p = 0; p < skip.size(); p++) {
+				skip[p] |= cached[p];
+			}
+		}
+	}
+
+	std::unique_ptr<RenderJob> job(new RenderJob(mViewportSize.width, mViewportSize.height, mGBuffer.channels,
+		std::move(columnX), std::move(rowY), mKernel, std::move(tiles), std::move(skip)));
+	job->start(pool, deadline);
+	return job;
+}
+
+void Display::setTileCache(TileCache *cache)
+{
+	mCache = cache;
+	if (mCache) {
+		const glm::dvec2 pitch = this->pitch();
+		mCenter = glm::round(mCenter / pitch) * pitch;
+	}
+}
+
+bool Display::latticeOrigin(glm::i64vec2 &origin) const
+{
+	// Pans accumulate rounding errors far below this:
+	const double TOLERANCE = 1e-3;
+
+	const glm::dvec2 point = mCenter / pitch();
+	const glm::dvec2 rounded = glm::round(point);
+	if (std::abs(point.x - rounded.x) > TOLERANCE || std::abs(point.y - rounded.y) > TOLERANCE) {
+		return false;
+	}
+	// See shaderX() and shaderY():
+	origin.x = static_cast<std::int64_t>(rounded.x) - mViewportOrigin.x;
+	origin.y = static_cast<std::int64_t>(rounded.y) + mViewportSize.height - mViewportOrigin.y;
+	return true;
+}
+
+/**
+ * Rounds towards negative infinity, unlike integer division.
+ */
+static std::int64_t floorDivide(std::int64_t a, std::int64_t b)
+{
+	return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+template<class Visit>
+void Display::forCacheTiles(const RenderJob::Tile &region, glm::i64vec2 origin, Visit &&tile) const
+{
+	const int size = TileCache::TILE_SIZE;
+	const int x0 = std::max(0, region.x);
+	const int y0 = std::max(0, region.y);
+	const int x1 = std::min(mViewportSize.width, region.x + region.width);
+	const int y1 = std::min(mViewportSize.height, region.y + region.height);
+	if (x0 >= x1 || y0 >= y1) {
+		return;
+	}
+
+	TileCache::Key key{ mFingerprint, mMaxIterations, mGBuffer.channels, pitch().x, pitch().y, 0, 0 };
+	// Lattice rows grow upwards, so the top row of the region has the highest tile:
+	for (key.tileY = floorDivide(origin.y - y0, size); key.tileY >= floorDivide(origin.y - (y1 - 1), size); key.tileY--) {
+		// Pixel rows of the tile, from its top row:
+		const int top = static_cast<int>(origin.y - (key.tileY * size + size - 1));
+		const int ty0 = std::max(y0, top);
+		const int ty1 = std::min(y1, top + size);
+		for (key.tileX = floorDivide(origin.x + x0, size); key.tileX <= floorDivide(origin.x + x1 - 1, size); key.tileX++) {
+			const int left = static_cast<int>(key.tileX * size - origin.x);
+			const int tx0 = std::max(x0, left);
+			const int tx1 = std::min(x1, left + size);
+			tile(key, tx0 - left, ty0 - top, tx0, ty0, tx1 - tx0, ty1 - ty0);
+		}
+	}
+}
+
+std::vector<std::uint8_t> Display::loadCached(const std::vector<RenderJob::Tile> &regions)
+{
+	glm::i64vec2 origin;
+	if (!mCache || !latticeOrigin(origin)) {
+		return {};
+	}
+
+	const int width = mViewportSize.width;
+	std::vector<std::uint8_t> cached(static_cast<size_t>(width) * mViewportSize.height, 0);
+	bool any = false;
+	for (const RenderJob::Tile &region : regions) {
+		forCacheTiles(region, origin, [&](const TileCache::Key &key, int u, int v, int x, int y, int w, int h) {
+			const TileCache::Tile *tile = mCache->find(key);
+			if (!tile) {
+				return;
+			}
+			for (int j = 0; j < h; j++) {
+				for (int i = 0; i < w; i++) {
+					size_t sample = static_cast<size_t>(v + j) * TileCache::TILE_SIZE + u + i;
+					if (tile->valid[sample]) {
+						mGBuffer.copyPixel(storedIndex(x + i, y + j), tile->samples, sample);
+						cached[static_cast<size_t>(y + j) * width + x + i] = 1;
+						any = true;
+					}
+				}
+			}
+		});
+	}
+	return any ? cached : std::vector<std::uint8_t>();
+}
+
+void Display::storeCached(const std::vector<RenderJob::Tile> &stale)
+{
+	glm::i64vec2 origin;
+	if (!mCache || !latticeOrigin(origin)) {
+		return;
+	}
+
+	const int width = mViewportSize.width;
+	const int height = mViewportSize.height;
+	std::vector<std::uint8_t> valid(static_cast<size_t>(width) * height, 1);
+	for (const RenderJob::Tile &r : stale) {
+		for (int y = std::max(0, r.y); y < std::min(height, r.y + r.height); y++) {
+			for (int x = std::max(0, r.x); x < std::min(width, r.x + r.width); x++) {
+				valid[static_cast<size_t>(y) * width + x] = 0;
+			}
+		}
+	}
+
+	forCacheTiles({ 0, 0, width, height }, origin, [&](const TileCache::Key &key, int u, int v, int x, int y, int w, int h) {
+		mCacheTile.samples.resize(TileCache::TILE_PIXELS, mGBuffer.channels);
+		mCacheTile.valid.reset();
+		for (int j = 0; j < h; j++) {
+			for (int i = 0; i < w; i++) {
+				if (valid[static_cast<size_t>(y + j) * width + x + i]) {
+					size_t sample = static_cast<size_t>(v + j) * TileCache::TILE_SIZE + u + i;
+					mCacheTile.samples.copyPixel(sample, mGBuffer, storedIndex(x + i, y + j));
+					mCacheTile.valid.set(sample);
+				}
+			}
+		}
+		if (mCacheTile.valid.any()) {
+			mCache->insert(key, mCacheTile);
+		}
+	});
+}
+
+std::vector<RenderJob::Tile> Display::pan(int dx, int dy)
+{
+	const int width = mViewportSize.width;
+	const int height = mViewportSize.height;
+	mCenter.x += dx * (shaderX(1) - shaderX(0));
+	mCenter.y += dy * (shaderY(1) - shaderY(0));
+
+	if (std::abs(dx) >= width || std::abs(dy) >= height) {
+		return { { 0, 0, width, height } };
+	}
+	mOrigin.x = ((mOrigin.x + dx) % width + width) % width;
+	mOrigin.y = ((mOrigin.y + dy) % height + height) % height;
+
+	// A strip of columns over the whole height, and one of rows beside it:
+	std::vector<RenderJob::Tile> exposed;
+	if (dx != 0) {
+		exposed.push_back({ dx > 0 ? width - dx : 0, 0, std::abs(dx), height });
+	}
+	if (dy != 0) {
+		exposed.push_back({ dx < 0 ? -dx : 0, dy > 0 ? height - dy : 0, width - std::abs(dx), std::abs(dy) });
+	}
+	return exposed;
+}
+
+std::vector<std::uint8_t> Display::zoomOctave(bool in, const std::vector<RenderJob::Tile> &stale)
+{
+	const int width = mViewportSize.width;
+	const int height = mViewportSize.height;
+
+	std::vector<std::uint8_t> valid(static_cast<size_t>(width) * height, 1);
+	for (const RenderJob::Tile &r : stale) {
+		for (int y = std::max(0, r.y); y < std::min(height, r.y + r.height); y++) {
+			for (int x = std::max(0, r.x); x < std::min(width, r.x + r.width); x++) {
+				valid[static_cast<size_t>(y) * width + x] = 0;
+			}
+		}
+	}
+
+	// The pixels the view scales about, see shaderX() and shaderY():
+	const int cx = mViewportOrigin.x;
+	const int cy = height - mViewportOrigin.y;
+	auto previous = [in](int pixel, int center, int &result) {
+		if (!in) {
+			result = center + 2 * (pixel - center);
+			return true;
+		}
+		result = center + (pixel - center) / 2;
+		return (pixel - center) % 2 == 0;
+	};
+
+	const glm::ivec2 previousOrigin = mOrigin;
+	std::swap(mGBuffer, mPrevious);
+	mGBuffer.resize(mPrevious.size, mPrevious.channels);
+	mOrigin = { 0, 0 };
+
+	std::vector<std::uint8_t> kept(valid.size(), 0);
+	for (int y = 0; y < height; y++) {
+		int py;
+		if (!previous(y, cy, py) || py < 0 || py >= height) {
+			continue;
+		}
+		for (int x = 0; x < width; x++) {
+			int px;
+			if (!previous(x, cx, px) || px < 0 || px >= width || !valid[static_cast<size_t>(py) * width + px]) {
+				continue;
+			}
+			size_t stored = static_cast<size_t>((py + previousOrigin.y) % height) * width + (px + previousOrigin.x) % width;
+			mGBuffer.copyPixel(static_cast<size_t>(y) * width + x, mPrevious, stored);
+			kept[static_cast<size_t>(y) * width + x] = 1;
+		}
+	}
+
+	mZoom = in ? mZoom * 2 : mZoom / 2;
+	return kept;
+}
+
+std::vector<RenderJob::Tile> Display::tilesReaching(const std::vector<RenderJob::Tile> &tiles, int iterations) const
+{
+	std::vector<RenderJob::Tile> reaching;
+	for (const RenderJob::Tile &t : tiles) {
+		bool reached = false;
+		for (int y = t.y; y < t.y + t.height && !reached; y++) {
+			for (int x = t.x; x < t.x + t.width; x++) {
+				reached |= mGBuffer.iterations[storedIndex(x, y)] >= iterations;
+			}
+		}
+		if (reached) {
+			reaching.push_back(t);
+		}
+	}
+	return reaching;
+}
+
+void Display::antialias()
+{
+	mSupersampler.refine(mGBuffer, mViewportSize.width, mViewportSize.height, mMaxIterations,
+		[this](const double *px, const double *py, int count, const GBufferSpan &out) {
+		mRowX.resize(count);
+		mRowY.resize(count);
+		for (int i = 0; i < count; i++) {
+			mRowX[i] = shaderX(px[i]);
+			mRowY[i] = shaderY(py[i]);
+		}
+		mKernel(mRowX.data(), mRowY.data(), count, out);
+	});
+}
+
+void Display::computePixels(const std::vector<size_t> &pixels)
+{
+	if (pixels.empty()) {
+		return;
+	}
+	int width = mViewportSize.width;
+	size_t count = pixels.size();
+	mScratch.resize(count, mGBuffer.channels);
+	mRowX.resize(count);
+	mRowY.resize(count);
+	for (size_t k = 0; k < count; k++) {
+		mRowX[k] = shaderX(static_cast<double>(pixels[k] % width));
+		mRowY[k] = shaderY(static_cast<double>(pixels[k] / width));
+	}
+
+	mKernel(mRowX.data(), mRowY.data(), static_cast<int>(count), mScratch.span());
+
+	for (size_t k = 0; k < count; k++) {
+		mGBuffer.copyPixel(pixels[k], mScratch, k);
+		mPixelState[pixels[k]] = PIXEL_COMPUTED;
+	}
+	mProgressiveStats.computed += count;
+}
+
+void Display::verifyGuesses(int step)
+{
+	const int width = mViewportSize.width;
+	const int height = mViewportSize.height;
+
+	// mPassPixels holds the pixels computed last, whose neighbours are checked:
+	while (!mPassPixels.empty()) {
+		mRecheck.clear();
+		for (size_t i : mPassPixels) {
+			int x = static_cast<int>(i % width);
+			int y = static_cast<int>(i / width);
+			const int neighbours[4][2] = { { x - step, y }, { x + step, y }, { x, y - step }, { x, y + step } };
+			for (const auto &n : neighbours) {
+				if (n[0] < 0 || n[0] >= width || n[1] < 0 || n[1] >= height) {
+					continue;
+				}
+				size_t j = static_cast<size_t>(n[1]) * width + n[0];
+				if (mPixelState[j] == PIXEL_GUESSED && mGBuffer.iterations[j] != mGBuffer.iterations[i]) {
+					mPixelState[j] = PIXEL_UNKNOWN;
+					mRecheck.push_back(j);
+				}
+			}
+		}
+		computePixels(mRecheck);
+		mPassPixels.swap(mRecheck);
+	}
+}
+
+void Display::fillFromLattice(int step)
+{
+	const int width = mViewportSize.width;
+	for (int y = 0; y < mViewportSize.height; y++) {
+		for (int x = 0; x < width; x++) {
+			if (x % step != 0 || y % step != 0) {
+				size_t corner = static_cast<size_t>(y - y % step) * width + (x - x % step);
+				mGBuffer.copyPixel(static_cast<size_t>(y) * width + x, mGBuffer, corner);
+			}
+		}
+	}
+}
+
+void Display::renderProgressive(const std::function<void(int step)> &onPass)
+{
+	const int width = mViewportSize.width;
+	const int height = mViewportSize.height;
+	auto index = [width](int x, int y) {
+		return static_cast<size_t>(y) * width + x;
+	};
+	auto centerOut = [&]() {
+		if (!mCenterOut) {
+			return;
+		}
+		auto distance = [&](size_t i) {
+			long dx = static_cast<long>(i % width) - width / 2;
+			long dy = static_cast<long>(i / width) - height / 2;
+			return dx * dx + dy * dy;
+		};
+		std::stable_sort(mPassPixels.begin(), mPassPixels.end(), [&](size_t a, size_t b) {
+			return distance(a) < distance(b);
+		});
+	};
+
+	mOrigin = { 0, 0 };
+	mPixelState.assign(mGBuffer.size, PIXEL_UNKNOWN);
+	mProgressiveStats = ProgressiveStats();
+
+	// The coarsest lattice is computed in full, it is what later passes guess from:
+	mPassPixels.clear();
+	for (int y = 0; y < height; y += PROGRESSIVE_STEP) {
+		for (int x = 0; x < width; x += PROGRESSIVE_STEP) {
+			mPassPixels.push_back(index(x, y));
+		}
+	}
+	centerOut();
+	computePixels(mPassPixels);
+	fillFromLattice(PROGRESSIVE_STEP);
+	onPass(PROGRESSIVE_STEP);
+
+	for (int step = PROGRESSIVE_STEP / 2; step >= 1; step /= 2) {
+		const int block = step * 2;
+		const int *iterations = mGBuffer.iterations.data();
+		// Smooth counts vary within an iteration band, so with them only the inside is solid:
+		const bool insideOnly = !mGBuffer.smooth.empty();
+
+		mPassPixels.clear();
+		for (int y = 0; y < height; y += step) {
+			for (int x = 0; x < width; x += step) {
+				if (x % block == 0 && y % block == 0) {
+					continue;
+				}
+				int bx = x - x % block;
+				int by = y - y % block;
+				int ex = bx + block;
+				int ey = by + block;
+				size_t corner = index(bx, by);
+				bool solid = ex < width && ey < height
+					&& (!insideOnly || iterations[corner] >= mMaxIterations)
+					&& iterations[index(ex, by)] == iterations[corner]
+					&& iterations[index(bx, ey)] == iterations[corner]
+					&& iterations[index(ex, ey)] == iterations[corner];
+				if (solid) {
+					mGBuffer.copyPixel(index(x, y), mGBuffer, corner);
+					mPixelState[index(x, y)] = PIXEL_GUESSED;
+				}
+				else {
+					mPassPixels.push_back(index(x, y));
+				}
+			}
+		}
+		centerOut();
+		computePixels(mPassPixels);
+		verifyGuesses(step);
+
+		if (step > 1) {
+			fillFromLattice(step);
+		}
+		else if (mAntialias) {
+			antialias();
+		}
+		onPass(step);
+	}
+
+	mProgressiveStats.guessed = static_cast<size_t>(std::count(mPixelState.begin(), mPixelState.end(), PIXEL_GUESSED));
+}
+
+void Display::colorizePixels(int y, int rows)
+{
+	const int width = mViewportSize.width;
+	mPixelColors.resize(static_cast<size_t>(width) * rows);
+	mInside.resize(static_cast<size_t>(width) * rows);
+
+	for (int r = 0; r < rows; r++) {
+		Rgb *colors = &mPixelColors[static_cast<size_t>(r) * width];
+		std::uint8_t *inside = &mInside[static_cast<size_t>(r) * width];
+		forRow(y + r, [&](size_t stored, int x, int count) {
+			if (mColoring == Coloring::HISTOGRAM) {
+				mPalette.colorizeEqualized(&mEqualized[stored], count, colors + x);
+			}
+			else {
+				mPalette.colorize(&mGBuffer.iterations[stored], count, colors + x);
+			}
+			const int *iterations = &mGBuffer.iterations[stored];
+			for (int i = 0; i < count; i++) {
+				inside[x + i] = iterations[i] >= mMaxIterations ? 1 : 0;
+			}
+		});
+	}
+}
+
+void Display::colorize()
+{
+	mPalette.build(mMaxIterations);
+
+	if (mColoring == Coloring::HISTOGRAM) {
+		mEqualized.resize(mGBuffer.size);
+		mEqualizer.equalize(*mPool, mGBuffer.iterations.data(), mGBuffer.smooth.data(), mGBuffer.size, mMaxIterations, mEqualized.data());
+	}
+
+	if (mOutput == Output::HALF_BLOCKS) {
+		const int width = mViewportSize.width;
+		for (int cy = 0; cy < mCells.height; cy++) {
+			colorizePixels(cy * 2, 2);
+			mBuffer[cy].clear();
+			cells::encodeHalfBlocks(&mPixelColors[0], &mPixelColors[width], width, mBuffer[cy]);
+		}
+		return;
+	}
+
+	if (mOutput == Output::BRAILLE) {
+		const int width = mViewportSize.width;
+		for (int cy = 0; cy < mCells.height; cy++) {
+			colorizePixels(cy * 4, 4);
+			const Rgb *colors[4];
+			const std::uint8_t *inside[4];
+			for (int r = 0; r < 4; r++) {
+				colors[r] = &mPixelColors[static_cast<size_t>(r) * width];
+				inside[r] = &mInside[static_cast<size_t>(r) * width];
+			}
+			mBuffer[cy].clear();
+			cells::encodeBraille(colors, inside, mCells.width, mPalette.insideColor(), mBuffer[cy]);
+		}
+		return;
 	}
 
-	// Print buffer:
 	for (int y = 0; y < mViewportSize.height; y++) {
-		std::cout << mBuffer[y] << '\n';
+		forRow(y, [&](size_t stored, int x, int count) {
+			if (mColoring == Coloring::HISTOGRAM) {
+				mPalette.colorizeEqualized(&mEqualized[stored], count, &mBuffer[y][x]);
+			}
+			else {
+				mPalette.colorize(&mGBuffer.iterations[stored], count, &mBuffer[y][x]);
+			}
+		});
+	}
+}
+
+void Display::present()
+{
+	if (mPresenter && mOutput == Output::CHARACTERS) {
+		// Anything printed before must reach the terminal first:
+		std::cout << std::flush;
+		mPresenter->present(mBuffer);
+		return;
+	}
+
+	for (const auto &row : mBuffer) {
+		std::cout << row << '\n';
 	}
 	std::cout << std::flush;
 }
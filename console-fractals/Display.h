@@ -1,50 +1,368 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <functional>
 #include <vector>
 #include "Dimension.h"
+#include "GBuffer.h"
+#include "Palette.h"
+#include "Histogram.h"
+#include "Supersampler.h"
+#include "Renderer.h"
+#include "TileCache.h"
+#include "TerminalPresenter.h"
+#include "ThreadPool.h"
 
 class Display
 {
 
 private:
 	
+	// Size in pixels, and in terminal cells:
 	Dimension mViewportSize;
+	Dimension mCells;
 
 	/**
-	 * A row-major back buffer
+	 * A row-major back buffer, one string per row of cells
 	*/
 	std::vector<std::string> mBuffer;
-	
-	std::function<char(double x, double y)> mShader;
+
+	/**
+	 * Row-major channels of the last render, all from the same escape pass.
+	 * Coloring reads only this, so a palette change never needs a new render.
+	 */
+	GBuffer mGBuffer;
+
+	// Stored position of pixel (0, 0). The G-buffer wraps around in both
+	// directions like a ring buffer, so a pan moves this instead of pixels:
+	glm::ivec2 mOrigin{ 0, 0 };
+
+	// The G-buffer before a zoom, reused to keep its allocation:
+	GBuffer mPrevious;
+
+	// Channels requested besides those the coloring needs:
+	unsigned mChannels = CHANNELS_BASIC;
+
+	// Equalized smooth counts for histogram coloring:
+	std::vector<float> mEqualized;
+
+	/**
+	 * Computes the escape iteration counts of `count` points at once, and
+	 * the other channels `out` has buffers for.
+	 */
+	std::function<void(const double *x, const double *y, int count, const GBufferSpan &out)> mKernel;
+
+	int mMaxIterations = 1;
+
+	Palette mPalette;
+
+	ThreadPool *mPool = nullptr;
+	HistogramEqualizer mEqualizer;
+
+	bool mAntialias = false;
+	Supersampler mSupersampler;
+
+	enum PixelState : std::uint8_t {
+		PIXEL_UNKNOWN,
+		PIXEL_COMPUTED,
+		// Filled from the corners of its block without computing:
+		PIXEL_GUESSED
+	};
+
+	// State of each pixel during a progressive render:
+	std::vector<std::uint8_t> mPixelState;
+
+	// Pixels of the current progressive pass, and guesses found wrong:
+	std::vector<size_t> mPassPixels;
+	std::vector<size_t> mRecheck;
+	GBuffer mScratch;
+
+	bool mCenterOut = false;
+
+	// Writes frames if set, instead of printing every row:
+	TerminalPresenter *mPresenter = nullptr;
+
+	// Colors and inside flags of the pixel rows of one row of cells:
+	std::vector<Rgb> mPixelColors;
+	std::vector<std::uint8_t> mInside;
+
+	// Scratch coordinates of the row being shaded:
+	std::vector<double> mRowX;
+	std::vector<double> mRowY;
 
 	glm::ivec2 mViewportOrigin;
 
-public:
+	// Tiles of earlier renders if set, and the hash of the request they depend on:
+	TileCache *mCache = nullptr;
+	std::uint64_t mFingerprint = 0;
+	TileCache::Tile mCacheTile;
 
-	static const double LOGIC_VIEWPORT_SIZE_MUL;
+	// Point of the plane shown at the viewport origin, and magnification:
+	glm::dvec2 mCenter{ 0, 0 };
+	double mZoom = 1;
+
+public:
 
 	enum class Origin {
 		CENTER
 	};
 
+	// Lattice spacing of the first progressive pass:
+	static const int PROGRESSIVE_STEP = 4;
+
+	struct ProgressiveStats
+	{
+		size_t computed = 0;
+		size_t guessed = 0;
+	};
+
+	enum class Output {
+		// One pixel per cell, drawn with the palette's characters:
+		CHARACTERS,
+		// Two pixels per cell in 24-bit color:
+		HALF_BLOCKS,
+		// 2x4 pixels per cell as Braille dots, inside the set:
+		BRAILLE
+	};
+
+	enum class Coloring {
+		// Palette indexed by iteration count:
+		ITERATIONS,
+		// Palette spread evenly over the escaped pixels, using smooth counts:
+		HISTOGRAM
+	};
+
+private:
+
+	Coloring mColoring = Coloring::ITERATIONS;
+	Output mOutput = Output::CHARACTERS;
+
+	/**
+	 * Colors pixel rows [y, y + rows) into mPixelColors and mInside.
+	 */
+	void colorizePixels(int y, int rows);
+
+	ProgressiveStats mProgressiveStats;
+
+	/**
+	 * Calls `segment(stored, x, count)` for the one or two runs of row `y`
+	 * which are contiguous in the G-buffer: `count` pixels from column `x`,
+	 * stored from index `stored` on.
+	 */
+	template<class Segment>
+	inline void forRow(int y, Segment &&segment) const {
+		const int width = mViewportSize.width;
+		size_t row = static_cast<size_t>((y + mOrigin.y) % mViewportSize.height) * width;
+		segment(row + mOrigin.x, 0, width - mOrigin.x);
+		if (mOrigin.x > 0) {
+			segment(row, width - mOrigin.x, mOrigin.x);
+		}
+	}
+
+	/**
+	 * Computes the given pixels with one kernel call and marks them computed.
+	 */
+	void computePixels(const std::vector<size_t> &pixels);
+
+	/**
+	 * Recomputes guessed pixels next to a computed pixel of another value,
+	 * until no guess on the lattice contradicts its computed neighbours.
+	 */
+	void verifyGuesses(int step);
+
+	/**
+	 * Fills the pixels between the lattice points with the lattice point at
+	 * their top left, so a pass can be shown before the next one.
+	 */
+	void fillFromLattice(int step);
+
+	void antialias();
+
+	/**
+	 * Distance between pixels in the plane.
+	 */
+	inline glm::dvec2 pitch() const {
+		return glm::dvec2(2 * RenderRequest::LOGIC_VIEWPORT_SIZE_MUL / mZoom) / glm::dvec2(mViewportSize.width, mViewportSize.height);
+	}
+
+	/**
+	 * Finds the tile cache lattice point of pixel (0, 0); pixel (x, y) is
+	 * point (origin.x + x, origin.y - y). Returns false if the pixels are
+	 * not on the lattice, e.g. after zooming out of a view centered on an
+	 * odd point, so there is nothing to share with the cache.
+	 */
+	bool latticeOrigin(glm::i64vec2 &origin) const;
+
+	/**
+	 * Calls `tile(key, u, v, x, y, width, height)` for the tile cache tiles
+	 * overlapping `region` of the view: `width` x `height` pixels from
+	 * pixel (x, y) on are the samples from (u, v) on in the tile.
+	 */
+	template<class Visit>
+	void forCacheTiles(const RenderJob::Tile &region, glm::i64vec2 origin, Visit &&tile) const;
+
+	/**
+	 * Copies the samples the cache has within `regions` into the G-buffer.
+	 * Returns the pixels copied, row-major, or nothing if none were.
+	 */
+	std::vector<std::uint8_t> loadCached(const std::vector<RenderJob::Tile> &regions);
+
+	inline void resizeGBuffer() {
+		bool smooth = mColoring == Coloring::HISTOGRAM || mAntialias;
+		unsigned channels = mChannels | (smooth ? static_cast<unsigned>(CHANNEL_SMOOTH) : 0u);
+		mGBuffer.resize(static_cast<size_t>(mViewportSize.width) * mViewportSize.height, channels);
+		mOrigin = { 0, 0 };
+	}
+
+public:
+
 	Display();
 
 	~Display();
 
+	/**
+	 * Sets the size in terminal cells. The size in pixels follows from the
+	 * output mode, so set that first.
+	 */
 	inline void setViewportSize(const Dimension &displaySize)
 	{
-		mViewportSize = displaySize;
+		mCells = displaySize;
+		switch (mOutput) {
+		case Output::CHARACTERS:
+			mViewportSize = displaySize;
+			break;
+		case Output::HALF_BLOCKS:
+			mViewportSize = Dimension{ displaySize.width, displaySize.height * 2 };
+			break;
+		case Output::BRAILLE:
+			mViewportSize = Dimension{ displaySize.width * 2, displaySize.height * 4 };
+			break;
+		}
 		mBuffer.resize(displaySize.height);
 		for (auto &row : mBuffer) {
 			row.resize(displaySize.width);
 		}
+		resizeGBuffer();
+	}
+
+	inline void setOutput(Output output) {
+		mOutput = output;
+	}
+
+	inline Output output() const {
+		return mOutput;
 	}
 
-	inline void setShader(decltype(mShader) &&shader) {
-		mShader = std::forward<decltype(mShader)>(shader);
+	/**
+	 * Histogram coloring needs a thread pool for its post-pass.
+	 */
+	inline void setColoring(Coloring coloring, ThreadPool *pool) {
+		mColoring = coloring;
+		mPool = pool;
+		resizeGBuffer();
+	}
+
+	/**
+	 * Channels to compute on every render, in addition to those the
+	 * coloring reads. Takes effect with the next render.
+	 */
+	inline void setChannels(unsigned channels) {
+		mChannels = channels;
+		resizeGBuffer();
+	}
+
+	/**
+	 * Supersamples the edge pixels of every render, see Supersampler.
+	 */
+	inline void setAntialiasing(bool antialias) {
+		mAntialias = antialias;
+		resizeGBuffer();
+	}
+
+	/**
+	 * Computes progressive passes in order of distance to the viewport
+	 * center instead of row by row.
+	 */
+	inline void setCenterOut(bool centerOut) {
+		mCenterOut = centerOut;
+	}
+
+	/**
+	 * Presents through `presenter`, which only sends what changed, or
+	 * prints all rows if null. Only used for character output.
+	 */
+	inline void setPresenter(TerminalPresenter *presenter) {
+		mPresenter = presenter;
+	}
+
+	inline const ProgressiveStats &progressiveStats() const {
+		return mProgressiveStats;
+	}
+
+	inline Supersampler &supersampler() {
+		return mSupersampler;
+	}
+
+	/**
+	 * Takes tiles from `cache`, if not null, instead of rendering them, and
+	 * stores the tiles of every complete render in it. Moves the center to
+	 * the nearest point of the cache's lattice, less than half a pixel away,
+	 * so pans and zooms in by octaves stay on it.
+	 */
+	void setTileCache(TileCache *cache);
+
+	/**
+	 * Sets the hash of the request the kernel belongs to, see
+	 * TileCache::fingerprint(), which tells cached tiles apart.
+	 */
+	inline void setFingerprint(std::uint64_t fingerprint) {
+		mFingerprint = fingerprint;
+	}
+
+	/**
+	 * Stores the pixels outside `stale` in the tile cache, if there is one.
+	 * Called with a complete render, or the parts of a partial one which
+	 * are up to date.
+	 */
+	void storeCached(const std::vector<RenderJob::Tile> &stale);
+
+	inline void setKernel(decltype(mKernel) &&kernel) {
+		mKernel = std::forward<decltype(mKernel)>(kernel);
+	}
+
+	/**
+	 * The cap the kernel iterates to. Pixels reaching it are inside the set.
+	 */
+	inline void setMaxIterations(int maxIterations) {
+		mMaxIterations = maxIterations;
+	}
+
+	inline int maxIterations() const {
+		return mMaxIterations;
+	}
+
+	inline Palette &palette() {
+		return mPalette;
+	}
+
+	/**
+	 * The G-buffer as stored, with pixel (x, y) at storedIndex(x, y).
+	 */
+	inline const std::vector<int> &iterations() const {
+		return mGBuffer.iterations;
+	}
+
+	inline const GBuffer &gbuffer() const {
+		return mGBuffer;
+	}
+
+	inline size_t storedIndex(int x, int y) const {
+		return static_cast<size_t>((y + mOrigin.y) % mViewportSize.height) * mViewportSize.width
+			+ (x + mOrigin.x) % mViewportSize.width;
 	}
 
 	inline void setViewportOrigin(glm::ivec2 viewportOrigin) {
@@ -58,6 +376,120 @@ public:
 		}
 	}
 
-	void draw();
+	inline void setCenter(glm::dvec2 center) {
+		mCenter = center;
+	}
+
+	inline void setZoom(double zoom) {
+		mZoom = zoom;
+	}
+
+	inline const glm::dvec2 &center() const {
+		return mCenter;
+	}
+
+	inline double zoom() const {
+		return mZoom;
+	}
+
+	inline const Dimension &viewportSize() const {
+		return mViewportSize;
+	}
+
+	/**
+	 * Maps a (possibly fractional) pixel column to the shader's x coordinate.
+	 */
+	inline double shaderX(double x) const {
+		return (x - mViewportOrigin.x) / mViewportSize.width * 2 * RenderRequest::LOGIC_VIEWPORT_SIZE_MUL / mZoom + mCenter.x;
+	}
+
+	/**
+	 * Maps a (possibly fractional) pixel row to the shader's y coordinate.
+	 */
+	inline double shaderY(double y) const {
+		return ((mViewportSize.height - y) - mViewportOrigin.y) / mViewportSize.height * 2 * RenderRequest::LOGIC_VIEWPORT_SIZE_MUL / mZoom + mCenter.y;
+	}
+
+	/**
+	 * Computes the G-buffer, taking the pixels the tile cache has from it.
+	 */
+	void render();
+
+	/**
+	 * Computes the G-buffer coarse to fine: first every PROGRESSIVE_STEP-th
+	 * pixel in both directions, then passes of half the spacing. A point of
+	 * a finer pass is guessed instead of computed if the four corners of
+	 * its block agree, as in solid guessing, and guesses contradicted by a
+	 * computed neighbour are computed after all. No pixel is computed
+	 * twice, so a progressive render never costs more than render().
+	 * Like any solid guessing, it can miss features thinner than a block
+	 * which touch none of its corners. With the smooth channel enabled,
+	 * only blocks inside the set are guessed.
+	 *
+	 * `onPass` is called with the spacing after each pass, with the whole
+	 * G-buffer filled and ready to be colorized and presented. The tile
+	 * cache is not used, as guessed pixels must not be stored.
+	 */
+	void renderProgressive(const std::function<void(int step)> &onPass);
+
+	/**
+	 * Starts computing the G-buffer of the current view in the background,
+	 * a tile at a time, and stops at the deadline if one is given. The
+	 * result, complete or not, is taken over with apply(). Antialiasing is
+	 * not applied to it. Renders the given tiles in order, or all tiles if
+	 * there are none, leaving out the pixels set in `skip` and those taken
+	 * from the tile cache.
+	 */
+	std::unique_ptr<RenderJob> renderAsync(ThreadPool &pool,
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(),
+		std::vector<RenderJob::Tile> tiles = {}, std::vector<std::uint8_t> skip = {});
+
+	/**
+	 * Copies the finished tiles of a job into the G-buffer, so a partial
+	 * frame shows the new tiles over the previous frame.
+	 * Returns the number of tiles copied.
+	 */
+	inline int apply(const RenderJob &job) {
+		return job.snapshot(mGBuffer, mOrigin.x, mOrigin.y);
+	}
+
+	/**
+	 * Moves the view by whole pixels, `dx` to the right and `dy` down,
+	 * keeping every pixel still in view. Only the ring buffer's origin
+	 * moves, no pixel is copied. Returns the newly exposed strips, which
+	 * hold stale pixels until rendered.
+	 */
+	std::vector<RenderJob::Tile> pan(int dx, int dy);
+
+	/**
+	 * Zooms in or out by a factor of two about the viewport origin, keeping
+	 * the pixels whose points were sampled before: every other pixel in
+	 * both directions on a zoom in, and the middle quarter of the view on
+	 * a zoom out. Scaling by two is exact, so the kept samples are the
+	 * same bit for bit. Pixels within `stale`, which hold nothing valid,
+	 * are not kept. Returns the kept pixels, row-major, to be skipped by
+	 * renderAsync().
+	 */
+	std::vector<std::uint8_t> zoomOctave(bool in, const std::vector<RenderJob::Tile> &stale);
+
+	/**
+	 * The tiles among `tiles` with a pixel that reached `iterations`. When
+	 * the cap moves from or to `iterations`, no other pixel changes, so only
+	 * these tiles need to be rendered again.
+	 */
+	std::vector<RenderJob::Tile> tilesReaching(const std::vector<RenderJob::Tile> &tiles, int iterations) const;
+
+	/**
+	 * Maps the G-buffer to characters in the back buffer.
+	 */
+	void colorize();
+
+	void present();
+
+	inline void draw() {
+		render();
+		colorize();
+		present();
+	}
 
 };
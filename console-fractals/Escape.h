@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include "Simd.h"
+#include "Formula.h"
+#include "GBuffer.h"
+
+/**
+ * Escape-time kernels iterating several pixels in lockstep.
+ *
+ * A single z = f(z) + c chain is a sequence of dependent multiplies, so the
+ * FP pipeline sits idle most of the time. The kernels below iterate a block
+ * of ESCAPE_INTERLEAVE independent SIMD packs per loop trip instead, which
+ * keeps that many multiply chains in flight.
+ */
+
+// Independent packs per block. Four cover the FMA latency on SSE/AVX
+// targets; AVX-512 packs are twice as wide already, so two suffice:
+#ifndef ESCAPE_INTERLEAVE
+#if defined(__AVX512F__)
+#define ESCAPE_INTERLEAVE 2
+#else
+#define ESCAPE_INTERLEAVE 4
+#endif
+#endif
+
+struct EscapeParams
+{
+	int maxIterations = 1;
+	bool julia = false;
+	double juliaX = 0;
+	double juliaY = 0;
+	// Point the orbit trap channel measures the distance to:
+	double trapX = 0;
+	double trapY = 0;
+};
+
+namespace escape {
+namespace {
+
+template<class Real>
+struct Block
+{
+	using Vec = typename simd::Pack<Real>::Vec;
+	using Mask = typename simd::Pack<Real>::Mask;
+	static constexpr int LANES = simd::Pack<Real>::LANES;
+	static constexpr int CHAINS = LANES * ESCAPE_INTERLEAVE;
+};
+
+/**
+ * Normalized iteration count: continuous in c, between n and n + 1 for a
+ * pixel which survived n iterations and escaped to |z|^2 = r2.
+ */
+inline float smoothIterations(int n, double r2, int degree)
+{
+	double nu = n + 1 - std::log(0.5 * std::log(r2) / std::log(2.0)) / std::log(static_cast<double>(degree));
+	return static_cast<float>(std::max(0.0, nu));
+}
+
+/**
+ * Exterior distance estimate from |z| and |dz/dc| at escape.
+ */
+inline float distanceEstimate(double r2, double d2)
+{
+	if (d2 <= 0) {
+		return 0;
+	}
+	double r = std::sqrt(r2);
+	return static_cast<float>(std::max(0.0, 0.5 * r * std::log(r) / std::sqrt(d2)));
+}
+
+/**
+ * Iterates up to Block::CHAINS pixels at once and stores the number of
+ * iterations each survived. A pixel which never escapes gets
+ * params.maxIterations. The formula is a policy from Formula.h.
+ * Channels in CHANNELS are computed along the same orbit and written to the
+ * non-null pointers of `out`; all others are compiled out.
+ */
+template<class Real, class F, unsigned CHANNELS>
+inline void iterateBlock(const EscapeParams &params, const double *x, const double *y, int count, const GBufferSpan &out)
+{
+	using B = Block<Real>;
+	using Vec = typename B::Vec;
+	using Mask = typename B::Mask;
+	constexpr int IL = ESCAPE_INTERLEAVE;
+	constexpr bool DISTANCE = (CHANNELS & CHANNEL_DISTANCE) != 0;
+	constexpr bool TRAP = (CHANNELS & CHANNEL_TRAP) != 0;
+	constexpr bool ESCAPED = (CHANNELS & (CHANNEL_SMOOTH | CHANNEL_MAGNITUDE | CHANNEL_DISTANCE)) != 0;
+
+	Vec zr[IL], zi[IL], cr[IL], ci[IL], n[IL];
+	Vec dr[IL], di[IL], trap[IL];
+	Mask alive[IL];
+
+	const Vec zero = simd::splat<Vec>(Real(0));
+	const Vec one = simd::splat<Vec>(Real(1));
+	const Vec four = simd::splat<Vec>(Real(4));
+	// dz/dc gains 1 per step for Mandelbrot-type sets, z0 is the pixel for Julia sets:
+	const Vec add = params.julia ? zero : one;
+	const Vec tr = simd::splat<Vec>(static_cast<Real>(params.trapX));
+	const Vec ti = simd::splat<Vec>(static_cast<Real>(params.trapY));
+
+	for (int k = 0; k < IL; k++) {
+		Vec px = zero, py = zero;
+		for (int l = 0; l < B::LANES; l++) {
+			int i = k * B::LANES + l;
+			// Padding lanes start outside the bailout radius and die at once:
+			simd::setLane(px, l, static_cast<Real>(i < count ? x[i] : 4));
+			simd::setLane(py, l, static_cast<Real>(i < count ? y[i] : 4));
+		}
+		zr[k] = px;
+		zi[k] = py;
+		cr[k] = params.julia ? simd::splat<Vec>(static_cast<Real>(params.juliaX)) : px;
+		ci[k] = params.julia ? simd::splat<Vec>(static_cast<Real>(params.juliaY)) : py;
+		n[k] = zero;
+		alive[k] = px == px;
+		if (DISTANCE) {
+			dr[k] = one;
+			di[k] = zero;
+		}
+		if (TRAP) {
+			trap[k] = (px - tr) * (px - tr) + (py - ti) * (py - ti);
+		}
+	}
+
+	for (int i = 0; i < params.maxIterations; i++) {
+		Mask any = alive[0] != alive[0];
+		for (int k = 0; k < IL; k++) {
+			Vec nzr = zr[k], nzi = zi[k];
+			F::step(nzr, nzi, cr[k], ci[k]);
+			Mask live = (nzr * nzr + nzi * nzi <= four) & alive[k];
+			if (DISTANCE) {
+				// The derivative is taken at the old z, and freezes with it:
+				Vec ndr = dr[k], ndi = di[k];
+				F::derivative(zr[k], zi[k], ndr, ndi, add);
+				dr[k] = simd::select(live, ndr, dr[k]);
+				di[k] = simd::select(live, ndi, di[k]);
+			}
+			if (TRAP) {
+				Vec d = (nzr - tr) * (nzr - tr) + (nzi - ti) * (nzi - ti);
+				trap[k] = simd::select(live & (d < trap[k]), d, trap[k]);
+			}
+			// Escaped lanes freeze instead of running off to infinity:
+			zr[k] = simd::select(live, nzr, zr[k]);
+			zi[k] = simd::select(live, nzi, zi[k]);
+			n[k] = simd::select(live, n[k] + one, n[k]);
+			alive[k] = live;
+			any = any | live;
+		}
+		if (!simd::any(any)) {
+			break;
+		}
+	}
+
+	for (int k = 0; k < IL; k++) {
+		// The frozen z is the last one inside, one more step escapes:
+		Vec er = zr[k], ei = zi[k];
+		Vec edr = zero, edi = zero;
+		if (ESCAPED) {
+			F::step(er, ei, cr[k], ci[k]);
+		}
+		if (DISTANCE) {
+			edr = dr[k];
+			edi = di[k];
+			F::derivative(zr[k], zi[k], edr, edi, add);
+		}
+
+		for (int l = 0; l < B::LANES; l++) {
+			int i = k * B::LANES + l;
+			if (i >= count) {
+				break;
+			}
+			int iterations = static_cast<int>(simd::lane(n[k], l));
+			bool escaped = iterations < params.maxIterations;
+			out.iterations[i] = iterations;
+
+			if (ESCAPED) {
+				double r = escaped ? simd::lane(er, l) : simd::lane(zr[k], l);
+				double im = escaped ? simd::lane(ei, l) : simd::lane(zi[k], l);
+				double r2 = r * r + im * im;
+				if ((CHANNELS & CHANNEL_SMOOTH) && out.smooth) {
+					out.smooth[i] = escaped ? smoothIterations(iterations, r2, F::DEGREE) : static_cast<float>(params.maxIterations);
+				}
+				if ((CHANNELS & CHANNEL_MAGNITUDE) && out.magnitude) {
+					out.magnitude[i] = static_cast<float>(std::sqrt(r2));
+				}
+				if (DISTANCE && out.distance) {
+					double d2 = static_cast<double>(simd::lane(edr, l)) * simd::lane(edr, l)
+						+ static_cast<double>(simd::lane(edi, l)) * simd::lane(edi, l);
+					out.distance[i] = escaped ? distanceEstimate(r2, d2) : 0.0f;
+				}
+			}
+			if (TRAP && out.trap) {
+				out.trap[i] = static_cast<float>(std::sqrt(static_cast<double>(simd::lane(trap[k], l))));
+			}
+		}
+	}
+}
+
+/**
+ * Computes the escape iteration counts of `count` arbitrary points, and the
+ * other channels of CHANNELS which `out` has buffers for.
+ */
+template<class Real, Formula FORMULA, unsigned CHANNELS>
+inline void escapeSpan(const EscapeParams &params, const double *x, const double *y, int count, const GBufferSpan &out)
+{
+	using F = typename formula::Policy<FORMULA>::Type;
+	constexpr int CHAINS = Block<Real>::CHAINS;
+	for (int i = 0; i < count; i += CHAINS) {
+		iterateBlock<Real, F, CHANNELS>(params, x + i, y + i, std::min(CHAINS, count - i), out.offset(i));
+	}
+}
+
+}
+}
@@ -0,0 +1,31 @@
+#include "Formula.h"
+#include <cstring>
+
+namespace {
+
+const char *const NAMES[FORMULA_COUNT] = {
+	"mandelbrot",
+	"multibrot3",
+	"multibrot4",
+	"multibrot5",
+	"tricorn",
+	"burning-ship"
+};
+
+}
+
+bool parseFormula(const char *name, Formula &formula)
+{
+	for (int i = 0; i < FORMULA_COUNT; i++) {
+		if (std::strcmp(name, NAMES[i]) == 0) {
+			formula = static_cast<Formula>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *formulaName(Formula formula)
+{
+	return NAMES[static_cast<int>(formula)];
+}
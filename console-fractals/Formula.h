@@ -0,0 +1,190 @@
+#pragma once
+
+#include "Simd.h"
+
+/**
+ * The iterated functions the escape kernels support.
+ */
+enum class Formula {
+	MANDELBROT,
+	MULTIBROT3,
+	MULTIBROT4,
+	MULTIBROT5,
+	TRICORN,
+	BURNING_SHIP
+};
+
+constexpr int FORMULA_COUNT = 6;
+
+/**
+ * Parses a formula name like "mandelbrot" or "burning-ship".
+ * Returns false for unknown names.
+ */
+bool parseFormula(const char *name, Formula &formula);
+
+const char *formulaName(Formula formula);
+
+/**
+ * Formula policies. Each maps z to f(z) + c on whole SIMD packs and is
+ * inlined into the escape kernel, so the inner loop never dispatches.
+ * derivative() advances dz/dc (plus `add`, 1 for Mandelbrot-type sets and 0
+ * for Julia sets) for the distance estimate. Only its magnitude matters, so
+ * the non-holomorphic formulas use the usual 2 |z| |dz| approximation.
+ */
+namespace formula {
+namespace {
+
+/**
+ * z^D by repeated squaring, unrolled at compile time.
+ */
+template<int D>
+struct Power
+{
+	template<class Vec>
+	static inline void apply(Vec &zr, Vec &zi)
+	{
+		Vec hr = zr, hi = zi;
+		Power<D / 2>::apply(hr, hi);
+		Vec sr = hr * hr - hi * hi;
+		Vec si = (hr + hr) * hi;
+		if (D % 2 == 1) {
+			Vec r = sr * zr - si * zi;
+			si = sr * zi + si * zr;
+			sr = r;
+		}
+		zr = sr;
+		zi = si;
+	}
+};
+
+template<>
+struct Power<1>
+{
+	template<class Vec>
+	static inline void apply(Vec &, Vec &)
+	{
+	}
+};
+
+/**
+ * z^D + c
+ */
+template<int D>
+struct Multibrot
+{
+	static constexpr int DEGREE = D;
+
+	template<class Vec>
+	static inline void step(Vec &zr, Vec &zi, const Vec &cr, const Vec &ci)
+	{
+		Power<D>::apply(zr, zi);
+		zr = zr + cr;
+		zi = zi + ci;
+	}
+
+	template<class Vec>
+	static inline void derivative(const Vec &zr, const Vec &zi, Vec &dr, Vec &di, const Vec &add)
+	{
+		// D z^(D-1) dz + add
+		Vec wr = zr, wi = zi;
+		Power<D - 1>::apply(wr, wi);
+		Vec r = wr * dr - wi * di;
+		Vec i = wr * di + wi * dr;
+		dr = r * D + add;
+		di = i * D;
+	}
+};
+
+/**
+ * conj(z)^2 + c
+ */
+struct Tricorn
+{
+	static constexpr int DEGREE = 2;
+
+	template<class Vec>
+	static inline void step(Vec &zr, Vec &zi, const Vec &cr, const Vec &ci)
+	{
+		Vec r = zr * zr - zi * zi + cr;
+		zi = ci - (zr + zr) * zi;
+		zr = r;
+	}
+
+	template<class Vec>
+	static inline void derivative(const Vec &zr, const Vec &zi, Vec &dr, Vec &di, const Vec &add)
+	{
+		// 2 conj(z) conj(dz) + add
+		Vec r = zr * dr - zi * di;
+		Vec i = zr * di + zi * dr;
+		dr = (r + r) + add;
+		di = -(i + i);
+	}
+};
+
+/**
+ * (|Re z| + i |Im z|)^2 + c
+ */
+struct BurningShip
+{
+	static constexpr int DEGREE = 2;
+
+	template<class Vec>
+	static inline void step(Vec &zr, Vec &zi, const Vec &cr, const Vec &ci)
+	{
+		Vec r = zr * zr - zi * zi + cr;
+		zi = simd::abs((zr + zr) * zi) + ci;
+		zr = r;
+	}
+
+	template<class Vec>
+	static inline void derivative(const Vec &zr, const Vec &zi, Vec &dr, Vec &di, const Vec &add)
+	{
+		// 2 z dz + add
+		Vec r = zr * dr - zi * di;
+		Vec i = zr * di + zi * dr;
+		dr = (r + r) + add;
+		di = i + i;
+	}
+};
+
+template<Formula F>
+struct Policy;
+
+template<>
+struct Policy<Formula::MANDELBROT>
+{
+	using Type = Multibrot<2>;
+};
+
+template<>
+struct Policy<Formula::MULTIBROT3>
+{
+	using Type = Multibrot<3>;
+};
+
+template<>
+struct Policy<Formula::MULTIBROT4>
+{
+	using Type = Multibrot<4>;
+};
+
+template<>
+struct Policy<Formula::MULTIBROT5>
+{
+	using Type = Multibrot<5>;
+};
+
+template<>
+struct Policy<Formula::TRICORN>
+{
+	using Type = Tricorn;
+};
+
+template<>
+struct Policy<Formula::BURNING_SHIP>
+{
+	using Type = BurningShip;
+};
+
+}
+}
@@ -0,0 +1,545 @@
+#include "FormulaVM.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// The class constants need definitions once bound by reference, as by std::min():
+const int FormulaProgram::BATCH;
+const int FormulaProgram::MAX_STACK;
+
+namespace {
+
+using Op = FormulaProgram::Op;
+using Instruction = FormulaProgram::Instruction;
+
+/**
+ * Recursive descent parser emitting postfix code.
+ */
+class Parser
+{
+
+public:
+
+	Parser(const std::string &source, std::vector<Instruction> &code, std::vector<std::complex<double>> &constants)
+		: mSource{ source }
+		, mCode{ code }
+		, mConstants{ constants }
+	{
+	}
+
+	bool parse(std::string &error)
+	{
+		if (!expr()) {
+			error = mError;
+			return false;
+		}
+		skipSpace();
+		if (mPos != mSource.size()) {
+			error = "unexpected '" + std::string(1, mSource[mPos]) + "' at " + std::to_string(mPos);
+			return false;
+		}
+		if (mMaxDepth > FormulaProgram::MAX_STACK) {
+			error = "formula nests too deeply";
+			return false;
+		}
+		return true;
+	}
+
+private:
+
+	const std::string &mSource;
+	std::vector<Instruction> &mCode;
+	std::vector<std::complex<double>> &mConstants;
+	size_t mPos = 0;
+	int mDepth = 0;
+	int mMaxDepth = 0;
+	std::string mError;
+
+	bool fail(const std::string &message)
+	{
+		if (mError.empty()) {
+			mError = message + " at " + std::to_string(mPos);
+		}
+		return false;
+	}
+
+	void emit(Op op, int operand = 0)
+	{
+		mCode.push_back({ op, operand });
+
+		switch (op) {
+		case Op::Z:
+		case Op::C:
+		case Op::CONSTANT:
+			mDepth++;
+			break;
+		case Op::ADD:
+		case Op::SUB:
+		case Op::MUL:
+		case Op::DIV:
+			mDepth--;
+			break;
+		default:
+			break;
+		}
+		mMaxDepth = std::max(mMaxDepth, mDepth);
+	}
+
+	void emitConstant(std::complex<double> value)
+	{
+		mConstants.push_back(value);
+		emit(Op::CONSTANT, static_cast<int>(mConstants.size() - 1));
+	}
+
+	void skipSpace()
+	{
+		while (mPos < mSource.size() && std::isspace(static_cast<unsigned char>(mSource[mPos]))) {
+			mPos++;
+		}
+	}
+
+	bool accept(char c)
+	{
+		skipSpace();
+		if (mPos < mSource.size() && mSource[mPos] == c) {
+			mPos++;
+			return true;
+		}
+		return false;
+	}
+
+	std::string identifier()
+	{
+		skipSpace();
+		size_t start = mPos;
+		while (mPos < mSource.size() && std::isalpha(static_cast<unsigned char>(mSource[mPos]))) {
+			mPos++;
+		}
+		return mSource.substr(start, mPos - start);
+	}
+
+	bool expr()
+	{
+		if (!term()) {
+			return false;
+		}
+		while (true) {
+			if (accept('+')) {
+				if (!term()) {
+					return false;
+				}
+				emit(Op::ADD);
+			}
+			else if (accept('-')) {
+				if (!term()) {
+					return false;
+				}
+				emit(Op::SUB);
+			}
+			else {
+				return true;
+			}
+		}
+	}
+
+	bool term()
+	{
+		if (!unary()) {
+			return false;
+		}
+		while (true) {
+			if (accept('*')) {
+				if (!unary()) {
+					return false;
+				}
+				emit(Op::MUL);
+			}
+			else if (accept('/')) {
+				if (!unary()) {
+					return false;
+				}
+				emit(Op::DIV);
+			}
+			else {
+				return true;
+			}
+		}
+	}
+
+	bool unary()
+	{
+		if (accept('-')) {
+			if (!unary()) {
+				return false;
+			}
+			emit(Op::NEG);
+			return true;
+		}
+		return power();
+	}
+
+	bool power()
+	{
+		if (!primary()) {
+			return false;
+		}
+		if (accept('^')) {
+			skipSpace();
+			char *end;
+			long exponent = std::strtol(mSource.c_str() + mPos, &end, 10);
+			if (end == mSource.c_str() + mPos || exponent < 0 || exponent > 64) {
+				return fail("expected an exponent between 0 and 64");
+			}
+			mPos = end - mSource.c_str();
+			if (exponent == 2) {
+				emit(Op::SQR);
+			}
+			else if (exponent != 1) {
+				emit(Op::POW, static_cast<int>(exponent));
+			}
+		}
+		return true;
+	}
+
+	bool primary()
+	{
+		skipSpace();
+		if (mPos >= mSource.size()) {
+			return fail("unexpected end of formula");
+		}
+
+		char c = mSource[mPos];
+		if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+			char *end;
+			double value = std::strtod(mSource.c_str() + mPos, &end);
+			mPos = end - mSource.c_str();
+			if (mPos < mSource.size() && mSource[mPos] == 'i') {
+				mPos++;
+				emitConstant({ 0, value });
+			}
+			else {
+				emitConstant({ value, 0 });
+			}
+			return true;
+		}
+
+		if (accept('(')) {
+			if (!expr()) {
+				return false;
+			}
+			return accept(')') || fail("expected ')'");
+		}
+
+		std::string name = identifier();
+		if (name == "z") {
+			emit(Op::Z);
+			return true;
+		}
+		if (name == "c") {
+			emit(Op::C);
+			return true;
+		}
+		if (name == "i") {
+			emitConstant({ 0, 1 });
+			return true;
+		}
+
+		static const struct {
+			const char *name;
+			Op op;
+		} FUNCTIONS[] = {
+			{ "re", Op::RE },
+			{ "im", Op::IM },
+			{ "abs", Op::ABS },
+			{ "conj", Op::CONJ },
+			{ "sqr", Op::SQR }
+		};
+		for (const auto &function : FUNCTIONS) {
+			if (name == function.name) {
+				if (!accept('(')) {
+					return fail("expected '(' after " + name);
+				}
+				if (!expr()) {
+					return false;
+				}
+				if (!accept(')')) {
+					return fail("expected ')'");
+				}
+				emit(function.op);
+				return true;
+			}
+		}
+
+		return fail(name.empty() ? "unexpected '" + std::string(1, c) + "'" : "unknown name '" + name + "'");
+	}
+
+};
+
+}
+
+bool FormulaProgram::compile(const std::string &source, std::string &error)
+{
+	std::vector<Instruction> code;
+	std::vector<std::complex<double>> constants;
+	Parser parser{ source, code, constants };
+	if (!parser.parse(error)) {
+		return false;
+	}
+
+	mSource = source;
+	mCode = std::move(code);
+	mConstants = std::move(constants);
+
+	// Degree in z of every stack slot, run like the program itself:
+	std::vector<int> degrees;
+	for (const Instruction &instruction : mCode) {
+		int top = degrees.empty() ? 0 : degrees.back();
+		switch (instruction.op) {
+		case Op::Z:
+			degrees.push_back(1);
+			break;
+		case Op::C:
+		case Op::CONSTANT:
+			degrees.push_back(0);
+			break;
+		case Op::ADD:
+		case Op::SUB:
+		case Op::MUL:
+		case Op::DIV: {
+			degrees.pop_back();
+			int &left = degrees.back();
+			if (instruction.op == Op::MUL) {
+				left += top;
+			}
+			else if (instruction.op == Op::DIV) {
+				left -= top;
+			}
+			else {
+				left = std::max(left, top);
+			}
+			break;
+		}
+		case Op::SQR:
+			degrees.back() = 2 * top;
+			break;
+		case Op::POW:
+			degrees.back() = top * instruction.operand;
+			break;
+		default:
+			// Signs, parts and absolute values keep the growth of |z|:
+			break;
+		}
+	}
+	// Orbits of lower degree do not escape geometrically, so there is nothing to normalize:
+	mDegree = degrees.empty() ? 2 : std::max(2, degrees.back());
+	return true;
+}
+
+void FormulaProgram::escape(const EscapeParams &params, const double *x, const double *y, int count, const GBufferSpan &out) const
+{
+	for (int i = 0; i < count; i += BATCH) {
+		escapeBatch(params, x + i, y + i, std::min(BATCH, count - i), out.offset(i));
+	}
+}
+
+void FormulaProgram::evaluate(const double *zr, const double *zi, const double *cr, const double *ci,
+	double (&re)[MAX_STACK][BATCH], double (&im)[MAX_STACK][BATCH]) const
+{
+	int sp = -1;
+
+	for (const Instruction &instruction : mCode) {
+		double *ar = re[sp < 0 ? 0 : sp];
+		double *ai = im[sp < 0 ? 0 : sp];
+
+		switch (instruction.op) {
+		case Op::Z:
+			sp++;
+			std::memcpy(re[sp], zr, sizeof(double) * BATCH);
+			std::memcpy(im[sp], zi, sizeof(double) * BATCH);
+			break;
+		case Op::C:
+			sp++;
+			std::memcpy(re[sp], cr, sizeof(double) * BATCH);
+			std::memcpy(im[sp], ci, sizeof(double) * BATCH);
+			break;
+		case Op::CONSTANT: {
+			sp++;
+			std::complex<double> value = mConstants[instruction.operand];
+			std::fill(re[sp], re[sp] + BATCH, value.real());
+			std::fill(im[sp], im[sp] + BATCH, value.imag());
+			break;
+		}
+		case Op::ADD:
+		case Op::SUB:
+		case Op::MUL:
+		case Op::DIV: {
+			// Binary operators combine the two topmost slots into the lower one:
+			double *br = re[sp];
+			double *bi = im[sp];
+			sp--;
+			ar = re[sp];
+			ai = im[sp];
+			if (instruction.op == Op::ADD) {
+				for (int l = 0; l < BATCH; l++) {
+					ar[l] += br[l];
+					ai[l] += bi[l];
+				}
+			}
+			else if (instruction.op == Op::SUB) {
+				for (int l = 0; l < BATCH; l++) {
+					ar[l] -= br[l];
+					ai[l] -= bi[l];
+				}
+			}
+			else if (instruction.op == Op::MUL) {
+				for (int l = 0; l < BATCH; l++) {
+					double r = ar[l] * br[l] - ai[l] * bi[l];
+					ai[l] = ar[l] * bi[l] + ai[l] * br[l];
+					ar[l] = r;
+				}
+			}
+			else {
+				for (int l = 0; l < BATCH; l++) {
+					double d = br[l] * br[l] + bi[l] * bi[l];
+					double r = (ar[l] * br[l] + ai[l] * bi[l]) / d;
+					ai[l] = (ai[l] * br[l] - ar[l] * bi[l]) / d;
+					ar[l] = r;
+				}
+			}
+			break;
+		}
+		case Op::NEG:
+			for (int l = 0; l < BATCH; l++) {
+				ar[l] = -ar[l];
+				ai[l] = -ai[l];
+			}
+			break;
+		case Op::SQR:
+			for (int l = 0; l < BATCH; l++) {
+				double r = ar[l] * ar[l] - ai[l] * ai[l];
+				ai[l] = 2 * ar[l] * ai[l];
+				ar[l] = r;
+			}
+			break;
+		case Op::POW: {
+			// Binary exponentiation, the same sequence for every lane:
+			double br[BATCH], bi[BATCH];
+			std::memcpy(br, ar, sizeof(br));
+			std::memcpy(bi, ai, sizeof(bi));
+			std::fill(ar, ar + BATCH, 1.0);
+			std::fill(ai, ai + BATCH, 0.0);
+			for (int e = instruction.operand; e > 0; e >>= 1) {
+				if (e & 1) {
+					for (int l = 0; l < BATCH; l++) {
+						double r = ar[l] * br[l] - ai[l] * bi[l];
+						ai[l] = ar[l] * bi[l] + ai[l] * br[l];
+						ar[l] = r;
+					}
+				}
+				for (int l = 0; l < BATCH; l++) {
+					double r = br[l] * br[l] - bi[l] * bi[l];
+					bi[l] = 2 * br[l] * bi[l];
+					br[l] = r;
+				}
+			}
+			break;
+		}
+		case Op::RE:
+			std::fill(ai, ai + BATCH, 0.0);
+			break;
+		case Op::IM:
+			for (int l = 0; l < BATCH; l++) {
+				ar[l] = ai[l];
+				ai[l] = 0;
+			}
+			break;
+		case Op::ABS:
+			for (int l = 0; l < BATCH; l++) {
+				ar[l] = std::sqrt(ar[l] * ar[l] + ai[l] * ai[l]);
+				ai[l] = 0;
+			}
+			break;
+		case Op::CONJ:
+			for (int l = 0; l < BATCH; l++) {
+				ai[l] = -ai[l];
+			}
+			break;
+		}
+	}
+}
+
+void FormulaProgram::escapeBatch(const EscapeParams &params, const double *x, const double *y, int count, const GBufferSpan &out) const
+{
+	// Every stack slot holds one complex value per lane:
+	double re[MAX_STACK][BATCH];
+	double im[MAX_STACK][BATCH];
+	double zr[BATCH], zi[BATCH], cr[BATCH], ci[BATCH], n[BATCH], trap[BATCH];
+	bool alive[BATCH];
+
+	for (int l = 0; l < BATCH; l++) {
+		// Padding lanes start outside the bailout radius and die at once:
+		double px = l < count ? x[l] : 4;
+		double py = l < count ? y[l] : 4;
+		zr[l] = px;
+		zi[l] = py;
+		cr[l] = params.julia ? params.juliaX : px;
+		ci[l] = params.julia ? params.juliaY : py;
+		n[l] = 0;
+		alive[l] = l < count;
+		trap[l] = (px - params.trapX) * (px - params.trapX) + (py - params.trapY) * (py - params.trapY);
+	}
+
+	for (int i = 0; i < params.maxIterations; i++) {
+		evaluate(zr, zi, cr, ci, re, im);
+
+		bool any = false;
+		for (int l = 0; l < BATCH; l++) {
+			double nzr = re[0][l];
+			double nzi = im[0][l];
+			bool live = alive[l] && nzr * nzr + nzi * nzi <= 4;
+			if (out.trap && live) {
+				double d = (nzr - params.trapX) * (nzr - params.trapX) + (nzi - params.trapY) * (nzi - params.trapY);
+				trap[l] = std::min(trap[l], d);
+			}
+			// Escaped lanes freeze instead of running off to infinity:
+			zr[l] = live ? nzr : zr[l];
+			zi[l] = live ? nzi : zi[l];
+			n[l] += live ? 1 : 0;
+			alive[l] = live;
+			any |= live;
+		}
+		if (!any) {
+			break;
+		}
+	}
+
+	bool stepped = out.smooth || out.magnitude;
+	if (stepped) {
+		// The frozen z is the last one inside, one more step escapes:
+		evaluate(zr, zi, cr, ci, re, im);
+	}
+
+	for (int l = 0; l < count; l++) {
+		int iterations = static_cast<int>(n[l]);
+		bool escaped = iterations < params.maxIterations;
+		out.iterations[l] = iterations;
+		if (stepped) {
+			double r = escaped ? re[0][l] : zr[l];
+			double i = escaped ? im[0][l] : zi[l];
+			if (out.smooth) {
+				out.smooth[l] = escaped ? escape::smoothIterations(iterations, r * r + i * i, mDegree) : static_cast<float>(params.maxIterations);
+			}
+			if (out.magnitude) {
+				out.magnitude[l] = static_cast<float>(std::sqrt(r * r + i * i));
+			}
+		}
+		if (out.distance) {
+			out.distance[l] = 0;
+		}
+		if (out.trap) {
+			out.trap[l] = static_cast<float>(std::sqrt(trap[l]));
+		}
+	}
+}
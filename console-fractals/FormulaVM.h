@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <complex>
+#include <string>
+#include <vector>
+#include "Escape.h"
+
+/**
+ * A user-defined iteration formula, compiled to bytecode for a small stack
+ * machine. The formula maps z and c to the next z, e.g. "z^3 + c" or
+ * "(abs(re(z)) + i*abs(im(z)))^2 + c".
+ *
+ * Grammar:
+ *   expr    := term (('+' | '-') term)*
+ *   term    := unary (('*' | '/') unary)*
+ *   unary   := '-' unary | power
+ *   power   := primary ('^' integer)?
+ *   primary := number ['i'] | 'i' | 'z' | 'c' | function '(' expr ')' | '(' expr ')'
+ *   function := re | im | abs | conj | sqr
+ *
+ * The interpreter runs each instruction over a whole batch of pixels, so
+ * decoding costs once per BATCH lanes and iteration, not once per pixel.
+ */
+class FormulaProgram
+{
+
+public:
+
+	static const int BATCH = 64;
+	static const int MAX_STACK = 16;
+
+	enum class Op : std::uint8_t {
+		Z,
+		C,
+		CONSTANT,
+		ADD,
+		SUB,
+		MUL,
+		DIV,
+		NEG,
+		POW,
+		RE,
+		IM,
+		ABS,
+		CONJ,
+		SQR
+	};
+
+	struct Instruction
+	{
+		Op op;
+		// Constant index for CONSTANT, exponent for POW:
+		int operand;
+	};
+
+	/**
+	 * Compiles the formula, replacing any previous program.
+	 * Returns false and describes the problem in `error` on syntax errors.
+	 */
+	bool compile(const std::string &source, std::string &error);
+
+	/**
+	 * Same contract as an EscapeKernel compiled for every channel, except
+	 * that the distance channel is always 0: the program has no derivative.
+	 */
+	void escape(const EscapeParams &params, const double *x, const double *y, int count, const GBufferSpan &out) const;
+
+	inline const std::string &source() const {
+		return mSource;
+	}
+
+	inline const std::vector<Instruction> &code() const {
+		return mCode;
+	}
+
+private:
+
+	std::string mSource;
+	std::vector<Instruction> mCode;
+	std::vector<std::complex<double>> mConstants;
+
+	// Degree of the formula in z, e.g. 5 for "z^3*z^2 + c", used to
+	// normalize smooth iteration counts:
+	int mDegree = 2;
+
+	/**
+	 * Runs the program once on a batch. The result ends up in slot 0.
+	 */
+	void evaluate(const double *zr, const double *zi, const double *cr, const double *ci,
+		double (&re)[MAX_STACK][BATCH], double (&im)[MAX_STACK][BATCH]) const;
+
+	void escapeBatch(const EscapeParams &params, const double *x, const double *y, int count, const GBufferSpan &out) const;
+
+};
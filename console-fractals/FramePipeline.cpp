@@ -0,0 +1,121 @@
+#include "FramePipeline.h"
+#include <chrono>
+
+// Tile messages in flight; workers wait while the colorizer is this far behind:
+static const size_t TILE_QUEUE_CAPACITY = 1024;
+
+FramePipeline::FramePipeline(ThreadPool &pool, const Palette &palette, std::FILE *out, DiskCache *cache)
+	: mRenderer(pool, cache),
+	mPool(pool),
+	mPalette(palette),
+	mOut(out),
+	mComputed(TILE_QUEUE_CAPACITY),
+	mColored(SLOTS),
+	mFree(SLOTS)
+{
+	for (int slot = 0; slot < SLOTS; slot++) {
+		mFree.tryPush(slot);
+	}
+	mColorizer = std::thread(&FramePipeline::colorize, this);
+	mWriter = std::thread(&FramePipeline::write, this);
+}
+
+FramePipeline::~FramePipeline()
+{
+	// Every slot is free again once the last frame has been written:
+	int spins = 0;
+	for (int freed = 0, slot; freed < SLOTS;) {
+		if (mFree.tryPop(slot)) {
+			freed++;
+		}
+		else {
+			backoff(spins);
+		}
+	}
+	mStopping = true;
+	mColorizer.join();
+	mWriter.join();
+}
+
+void FramePipeline::submit(const RenderRequest &request)
+{
+	using Clock = std::chrono::steady_clock;
+	auto start = Clock::now();
+
+	int slot;
+	int spins = 0;
+	while (!mFree.tryPop(slot)) {
+		backoff(spins);
+	}
+	auto acquired = Clock::now();
+
+	Frame &frame = mFrames[slot];
+	const int width = request.width;
+	frame.request = request;
+	frame.tiles = RenderJob::tiles(width, request.height, false);
+	frame.tilesColored = 0;
+	frame.text.resize(static_cast<size_t>(width + 1) * request.height);
+	for (int y = 0; y < request.height; y++) {
+		frame.text[static_cast<size_t>(y) * (width + 1) + width] = '\n';
+	}
+
+	mRenderer.render(request, frame.gbuffer, [this, slot](int tile) {
+		int spins = 0;
+		while (!mComputed.tryPush({ slot, tile })) {
+			backoff(spins);
+		}
+	});
+
+	mStats.frames++;
+	mStats.stallSeconds += std::chrono::duration<double>(acquired - start).count();
+	mStats.computeSeconds += std::chrono::duration<double>(Clock::now() - acquired).count();
+}
+
+void FramePipeline::colorize()
+{
+	int spins = 0;
+	while (!mStopping) {
+		TileMessage message;
+		if (!mComputed.tryPop(message)) {
+			backoff(spins);
+			continue;
+		}
+		spins = 0;
+
+		Frame &frame = mFrames[message.slot];
+		const RenderJob::Tile &t = frame.tiles[message.tile];
+		const int width = frame.request.width;
+		mPalette.build(frame.request.params.maxIterations);
+		for (int row = t.y; row < t.y + t.height; row++) {
+			mPalette.colorize(&frame.gbuffer.iterations[static_cast<size_t>(row) * width + t.x], t.width,
+				&frame.text[static_cast<size_t>(row) * (width + 1) + t.x]);
+		}
+
+		if (++frame.tilesColored == static_cast<int>(frame.tiles.size())) {
+			while (!mColored.tryPush(message.slot)) {
+				backoff(spins);
+			}
+		}
+	}
+}
+
+void FramePipeline::write()
+{
+	int spins = 0;
+	while (!mStopping) {
+		int slot;
+		if (!mColored.tryPop(slot)) {
+			backoff(spins);
+			continue;
+		}
+		spins = 0;
+
+		const Frame &frame = mFrames[slot];
+		std::fwrite(frame.text.data(), 1, frame.text.size(), mOut);
+		std::fflush(mOut);
+
+		while (!mFree.tryPush(slot)) {
+			backoff(spins);
+		}
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "BoundedQueue.h"
+#include "Palette.h"
+#include "Renderer.h"
+
+/**
+ * Renders a sequence of frames in three overlapping stages: tiles are
+ * computed on the pool, colorized by one thread as soon as each tile is
+ * done, and whole frames are written by one output thread. While a frame
+ * is being written, the next one is already being computed.
+ *
+ * The stages hand tiles and frames over through bounded lock-free queues.
+ * Two frame slots alternate, so at most one frame waits for output while
+ * the next is computed.
+ *
+ * Frames are colorized per tile with the palette's iteration lookup, so
+ * coloring which needs the whole frame, like histogram equalization, is
+ * not available here.
+ */
+class FramePipeline
+{
+
+public:
+
+	static const int SLOTS = 2;
+
+	struct Stats
+	{
+		int frames = 0;
+		double computeSeconds = 0;
+		// Time submit() waited for a free slot, i.e. for output to catch up:
+		double stallSeconds = 0;
+	};
+
+private:
+
+	struct Frame
+	{
+		RenderRequest request;
+		std::vector<RenderJob::Tile> tiles;
+		GBuffer gbuffer;
+		// Rows of characters, each ending in a newline:
+		std::vector<char> text;
+		int tilesColored = 0;
+	};
+
+	// A computed tile on its way to the colorize stage:
+	struct TileMessage
+	{
+		int slot;
+		int tile;
+	};
+
+	Renderer mRenderer;
+	ThreadPool &mPool;
+	Palette mPalette;
+	std::FILE *mOut;
+
+	Frame mFrames[SLOTS];
+
+	BoundedQueue<TileMessage> mComputed;
+	BoundedQueue<int> mColored;
+	BoundedQueue<int> mFree;
+
+	std::atomic<bool> mStopping{ false };
+	std::thread mColorizer;
+	std::thread mWriter;
+
+	Stats mStats;
+
+	void colorize();
+
+	void write();
+
+public:
+
+	/**
+	 * Colors frames with a copy of `palette` and writes them to `out`,
+	 * taking the renders `cache` has from it if given.
+	 */
+	FramePipeline(ThreadPool &pool, const Palette &palette, std::FILE *out, DiskCache *cache = nullptr);
+
+	/**
+	 * Waits for all submitted frames to be written.
+	 */
+	~FramePipeline();
+
+	FramePipeline(const FramePipeline &) = delete;
+
+	FramePipeline &operator=(const FramePipeline &) = delete;
+
+	/**
+	 * Computes a frame and hands it on to the later stages. Returns once
+	 * its tiles are computed, which is usually before the previous frame
+	 * has been written.
+	 */
+	void submit(const RenderRequest &request);
+
+	inline const Stats &stats() const {
+		return mStats;
+	}
+
+};
@@ -0,0 +1,70 @@
+#include "FrameScheduler.h"
+#include <algorithm>
+#include <thread>
+
+// Age of a tile which has never been rendered:
+static const int NEVER = 1 << 20;
+
+FrameScheduler::FrameScheduler(double framesPerSecond)
+	: mBudget(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / framesPerSecond)))
+{
+}
+
+FrameScheduler::FrameStats FrameScheduler::frame(Display &display, ThreadPool &pool, const std::function<void()> &present)
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+	const int width = display.viewportSize().width;
+	const int height = display.viewportSize().height;
+	const int columns = (width + RenderJob::TILE_SIZE - 1) / RenderJob::TILE_SIZE;
+	const int rows = (height + RenderJob::TILE_SIZE - 1) / RenderJob::TILE_SIZE;
+
+	if (mColumns != columns || mAge.size() != static_cast<size_t>(columns) * rows) {
+		mColumns = columns;
+		mAge.assign(static_cast<size_t>(columns) * rows, NEVER);
+	}
+	auto grid = [columns](const RenderJob::Tile &t) {
+		return static_cast<size_t>(t.y / RenderJob::TILE_SIZE) * columns + t.x / RenderJob::TILE_SIZE;
+	};
+
+	// Center-out order, then the stalest first:
+	std::vector<RenderJob::Tile> tiles = RenderJob::tiles(width, height, true);
+	std::stable_sort(tiles.begin(), tiles.end(), [&](const RenderJob::Tile &a, const RenderJob::Tile &b) {
+		return mAge[grid(a)] > mAge[grid(b)];
+	});
+
+	// Leave time for presenting, but never less than a quarter of the budget for rendering:
+	auto reserve = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(mPresentSeconds));
+	auto deadline = start + std::max(mBudget - reserve, mBudget / 4);
+
+	std::unique_ptr<RenderJob> job = display.renderAsync(pool, deadline, tiles);
+	job->wait();
+	display.apply(*job);
+	const auto rendered = Clock::now();
+
+	FrameStats stats;
+	stats.tileCount = job->tileCount();
+	for (int t = 0; t < job->tileCount(); t++) {
+		int &age = mAge[grid(job->tileList()[t])];
+		if (job->tileDone(t)) {
+			age = 0;
+			stats.tilesRendered++;
+		}
+		else if (age < NEVER) {
+			age++;
+		}
+		stats.maxAge = std::max(stats.maxAge, age);
+	}
+
+	display.colorize();
+	present();
+	const auto presented = Clock::now();
+
+	double presentSeconds = std::chrono::duration<double>(presented - rendered).count();
+	mPresentSeconds = mPresentSeconds == 0 ? presentSeconds : mPresentSeconds * 0.9 + presentSeconds * 0.1;
+
+	stats.renderMilliseconds = std::chrono::duration<double, std::milli>(rendered - start).count();
+	std::this_thread::sleep_until(start + mBudget);
+	stats.frameMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	return stats;
+}
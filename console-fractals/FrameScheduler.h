@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <vector>
+#include "Display.h"
+
+/**
+ * Renders frames within a fixed time budget for real-time animation.
+ *
+ * Every frame renders tiles until the budget, less the time presenting
+ * takes, runs out. Tiles it does not reach keep their content from earlier
+ * frames and move to the front of the next frame's queue, oldest first, so
+ * every tile is refreshed eventually. Among tiles of equal age, the ones
+ * closest to the center go first.
+ */
+class FrameScheduler
+{
+
+public:
+
+	struct FrameStats
+	{
+		int tilesRendered = 0;
+		int tileCount = 0;
+		// Frames since the stalest tile on screen was rendered:
+		int maxAge = 0;
+		double renderMilliseconds = 0;
+		double frameMilliseconds = 0;
+	};
+
+private:
+
+	std::chrono::steady_clock::duration mBudget;
+
+	// Frames since each tile of the grid was last rendered:
+	std::vector<int> mAge;
+	int mColumns = 0;
+
+	// Running average of colorizing and presenting, reserved from the budget:
+	double mPresentSeconds = 0;
+
+public:
+
+	explicit FrameScheduler(double framesPerSecond);
+
+	/**
+	 * Renders, colorizes and presents one frame of the display's current
+	 * view on `pool`, then waits for the end of the frame's time slot.
+	 * `present` shows the colorized display.
+	 */
+	FrameStats frame(Display &display, ThreadPool &pool, const std::function<void()> &present);
+
+	/**
+	 * Forgets all tiles, e.g. after a resize or a jump of the view.
+	 */
+	inline void invalidate() {
+		mAge.clear();
+	}
+
+};
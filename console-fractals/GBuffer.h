@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Per-pixel outputs an escape pass can produce. Kernels are compiled for a
+ * fixed channel mask, so channels outside it cost nothing.
+ */
+enum Channel : unsigned {
+	// Iterations survived, the cap for pixels inside the set:
+	CHANNEL_ITERATIONS = 1 << 0,
+	// Normalized iteration count, continuous across iteration bands:
+	CHANNEL_SMOOTH = 1 << 1,
+	// |z| after the last iteration:
+	CHANNEL_MAGNITUDE = 1 << 2,
+	// Exterior distance estimate to the set, 0 inside:
+	CHANNEL_DISTANCE = 1 << 3,
+	// Closest approach of the orbit to the trap point:
+	CHANNEL_TRAP = 1 << 4
+};
+
+/**
+ * Channel masks the kernels are instantiated for. A request is served by the
+ * smallest one containing it.
+ */
+const unsigned CHANNELS_BASIC = CHANNEL_ITERATIONS;
+const unsigned CHANNELS_SMOOTH = CHANNEL_ITERATIONS | CHANNEL_SMOOTH | CHANNEL_MAGNITUDE;
+const unsigned CHANNELS_ALL = CHANNELS_SMOOTH | CHANNEL_DISTANCE | CHANNEL_TRAP;
+
+const int CHANNEL_PRESET_COUNT = 3;
+
+/**
+ * Index of the smallest preset containing `channels`.
+ */
+inline int channelPreset(unsigned channels)
+{
+	if ((channels & ~CHANNELS_BASIC) == 0) {
+		return 0;
+	}
+	if ((channels & ~CHANNELS_SMOOTH) == 0) {
+		return 1;
+	}
+	return 2;
+}
+
+/**
+ * Destination of one kernel call. Channels with a null pointer are skipped.
+ */
+struct GBufferSpan
+{
+	int *iterations = nullptr;
+	float *smooth = nullptr;
+	float *magnitude = nullptr;
+	float *distance = nullptr;
+	float *trap = nullptr;
+
+	inline GBufferSpan offset(size_t i) const {
+		GBufferSpan span;
+		span.iterations = iterations ? iterations + i : nullptr;
+		span.smooth = smooth ? smooth + i : nullptr;
+		span.magnitude = magnitude ? magnitude + i : nullptr;
+		span.distance = distance ? distance + i : nullptr;
+		span.trap = trap ? trap + i : nullptr;
+		return span;
+	}
+
+	inline unsigned channels() const {
+		unsigned channels = 0;
+		channels |= iterations ? static_cast<unsigned>(CHANNEL_ITERATIONS) : 0u;
+		channels |= smooth ? static_cast<unsigned>(CHANNEL_SMOOTH) : 0u;
+		channels |= magnitude ? static_cast<unsigned>(CHANNEL_MAGNITUDE) : 0u;
+		channels |= distance ? static_cast<unsigned>(CHANNEL_DISTANCE) : 0u;
+		channels |= trap ? static_cast<unsigned>(CHANNEL_TRAP) : 0u;
+		return channels;
+	}
+};
+
+/**
+ * Row-major buffers of the enabled channels.
+ */
+struct GBuffer
+{
+	unsigned channels = CHANNEL_ITERATIONS;
+	size_t size = 0;
+	std::vector<int> iterations;
+	std::vector<float> smooth;
+	std::vector<float> magnitude;
+	std::vector<float> distance;
+	std::vector<float> trap;
+
+	inline void resize(size_t pixels, unsigned enabled) {
+		size = pixels;
+		channels = enabled | CHANNEL_ITERATIONS;
+		iterations.resize(pixels);
+		smooth.resize(channels & CHANNEL_SMOOTH ? pixels : 0);
+		magnitude.resize(channels & CHANNEL_MAGNITUDE ? pixels : 0);
+		distance.resize(channels & CHANNEL_DISTANCE ? pixels : 0);
+		trap.resize(channels & CHANNEL_TRAP ? pixels : 0);
+	}
+
+	/**
+	 * Copies every enabled channel of pixel `from` of `source`, which must
+	 * have at least the channels of this buffer, to pixel `to`.
+	 */
+	inline void copyPixel(size_t to, const GBuffer &source, size_t from) {
+		iterations[to] = source.iterations[from];
+		if (!smooth.empty()) {
+			smooth[to] = source.smooth[from];
+		}
+		if (!magnitude.empty()) {
+			magnitude[to] = source.magnitude[from];
+		}
+		if (!distance.empty()) {
+			distance[to] = source.distance[from];
+		}
+		if (!trap.empty()) {
+			trap[to] = source.trap[from];
+		}
+	}
+
+	inline GBufferSpan span(size_t i = 0) {
+		GBufferSpan span;
+		span.iterations = iterations.data() + i;
+		span.smooth = smooth.empty() ? nullptr : smooth.data() + i;
+		span.magnitude = magnitude.empty() ? nullptr : magnitude.data() + i;
+		span.distance = distance.empty() ? nullptr : distance.data() + i;
+		span.trap = trap.empty() ? nullptr : trap.data() + i;
+		return span;
+	}
+};
@@ -0,0 +1,290 @@
+#include "GraphicsPresenter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include "BoundedQueue.h"
+#include "TerminalPresenter.h"
+
+// RGB bytes per Kitty chunk, which encode to the 4096 base64 characters a chunk may hold:
+static const size_t KITTY_CHUNK = 3072;
+
+// Repetitions worth a sixel repeat introducer, "!n":
+static const int SIXEL_REPEAT_MIN = 4;
+
+static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+GraphicsPresenter::GraphicsPresenter(Protocol protocol, int fd)
+	: mProtocol(protocol),
+	mFd(fd)
+{
+	std::memset(mUsed, 0, sizeof(mUsed));
+}
+
+void GraphicsPresenter::flush()
+{
+	TerminalPresenter::write(mFd, mOut.data(), mOut.size());
+	mStats.bytes += mOut.size();
+	mOut.clear();
+}
+
+void GraphicsPresenter::present(Renderer &renderer, const RenderRequest &request, Palette &palette)
+{
+	using Clock = std::chrono::steady_clock;
+	auto start = Clock::now();
+	Clock::duration encoding{ 0 };
+
+	const int width = request.width;
+	const int height = request.height;
+	const int maxIterations = request.params.maxIterations;
+	palette.build(maxIterations);
+
+	mStats = Stats();
+	mOut.clear();
+	if (mProtocol == Protocol::SIXEL) {
+		buildRegisters(palette, maxIterations);
+		beginSixel(width, height);
+	}
+	else {
+		beginKitty();
+	}
+
+	std::unique_ptr<RenderJob> job = renderer.renderAsync(request);
+	const GBuffer &gbuffer = job->gbuffer();
+	const int columns = (width + RenderJob::TILE_SIZE - 1) / RenderJob::TILE_SIZE;
+
+	// Rows of tiles are taken in order, each as soon as all of its tiles are done:
+	int encodedRows = 0;
+	for (int tile = 0; tile < job->tileCount(); tile += columns) {
+		for (int t = tile; t < tile + columns; t++) {
+			int spins = 0;
+			while (!job->tileDone(t)) {
+				backoff(spins);
+			}
+		}
+		auto encodeStart = Clock::now();
+
+		const RenderJob::Tile &first = job->tileList()[tile];
+		const int rowEnd = first.y + first.height;
+		if (mProtocol == Protocol::SIXEL) {
+			const std::uint8_t *lut = mRegisterLut.data();
+			for (int y = first.y; y < rowEnd; y++) {
+				const int *iterations = &gbuffer.iterations[static_cast<size_t>(y) * width];
+				std::uint8_t *registers = &mRegisters[static_cast<size_t>(y) * width];
+				for (int x = 0; x < width; x++) {
+					registers[x] = lut[std::min(iterations[x], maxIterations)];
+				}
+			}
+			// Bands are six rows, so the last few rows wait for the next row of tiles:
+			for (; encodedRows + 6 <= rowEnd || (rowEnd == height && encodedRows < height); encodedRows += 6) {
+				encodeBand(width, height, encodedRows);
+			}
+		}
+		else {
+			mColors.resize(static_cast<size_t>(width) * first.height);
+			palette.colorize(&gbuffer.iterations[static_cast<size_t>(first.y) * width], static_cast<int>(mColors.size()),
+				mColors.data());
+			encodeKitty(mColors.data(), mColors.size(), width, height);
+		}
+
+		encoding += Clock::now() - encodeStart;
+		flush();
+	}
+
+	if (mProtocol == Protocol::SIXEL) {
+		mOut.insert(mOut.end(), { '\x1b', '\\' });
+	}
+	else {
+		appendKittyChunk(mPending.data(), mPending.size(), false, width, height);
+		mPending.clear();
+	}
+	mOut.push_back('\n');
+	flush();
+
+	mStats.encodeSeconds = std::chrono::duration<double>(encoding).count();
+	mStats.frameSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void GraphicsPresenter::buildRegisters(const Palette &palette, int maxIterations)
+{
+	std::vector<int> iterations(maxIterations + 1);
+	for (int n = 0; n <= maxIterations; n++) {
+		iterations[n] = n;
+	}
+	std::vector<Rgb> colors(iterations.size());
+	palette.colorize(iterations.data(), static_cast<int>(iterations.size()), colors.data());
+
+	mRegisterLut.resize(iterations.size());
+	mRegisterColors.clear();
+	std::map<std::uint32_t, std::uint8_t> registers;
+	for (size_t n = 0; n < colors.size() && mRegisterColors.size() <= REGISTERS; n++) {
+		std::uint32_t key = colors[n].r << 16 | colors[n].g << 8 | colors[n].b;
+		auto found = registers.find(key);
+		if (found == registers.end()) {
+			found = registers.emplace(key, static_cast<std::uint8_t>(mRegisterColors.size())).first;
+			mRegisterColors.push_back(colors[n]);
+		}
+		mRegisterLut[n] = found->second;
+	}
+
+	if (mRegisterColors.size() > REGISTERS) {
+		// Too many colors, so use a 6x6x6 color cube instead:
+		mRegisterColors.clear();
+		for (int i = 0; i < 216; i++) {
+			mRegisterColors.push_back({
+				static_cast<std::uint8_t>(i / 36 * 51),
+				static_cast<std::uint8_t>(i / 6 % 6 * 51),
+				static_cast<std::uint8_t>(i % 6 * 51)
+			});
+		}
+		for (size_t n = 0; n < colors.size(); n++) {
+			mRegisterLut[n] = static_cast<std::uint8_t>((colors[n].r + 25) / 51 * 36 + (colors[n].g + 25) / 51 * 6 + (colors[n].b + 25) / 51);
+		}
+	}
+}
+
+void GraphicsPresenter::beginSixel(int width, int height)
+{
+	mRegisters.resize(static_cast<size_t>(width) * height);
+	mSixels.assign(static_cast<size_t>(REGISTERS) * width, 0);
+
+	// Square pixels and the image size, then the registers in percent:
+	mOut.insert(mOut.end(), { '\x1b', 'P', 'q', '"', '1', ';', '1', ';' });
+	appendNumber(mOut, width);
+	mOut.push_back(';');
+	appendNumber(mOut, height);
+	for (size_t i = 0; i < mRegisterColors.size(); i++) {
+		const Rgb &color = mRegisterColors[i];
+		mOut.push_back('#');
+		appendNumber(mOut, static_cast<int>(i));
+		mOut.insert(mOut.end(), { ';', '2', ';' });
+		appendNumber(mOut, (color.r * 100 + 127) / 255);
+		mOut.push_back(';');
+		appendNumber(mOut, (color.g * 100 + 127) / 255);
+		mOut.push_back(';');
+		appendNumber(mOut, (color.b * 100 + 127) / 255);
+	}
+}
+
+void GraphicsPresenter::encodeBand(int width, int height, int y)
+{
+	// Sort the band's dots by register in one pass over its pixels:
+	const int rows = std::min(6, height - y);
+	for (int row = 0; row < rows; row++) {
+		const std::uint8_t *registers = &mRegisters[static_cast<size_t>(y + row) * width];
+		const std::uint8_t bit = static_cast<std::uint8_t>(1 << row);
+		for (int x = 0; x < width; x++) {
+			std::uint8_t r = registers[x];
+			mSixels[static_cast<size_t>(r) * width + x] |= bit;
+			mUsed[r] = 1;
+		}
+	}
+
+	// One pass over the band per register it uses, returning to its start with '$':
+	bool firstColor = true;
+	for (int r = 0; r < REGISTERS; r++) {
+		if (!mUsed[r]) {
+			continue;
+		}
+		mUsed[r] = 0;
+		std::uint8_t *sixels = &mSixels[static_cast<size_t>(r) * width];
+
+		if (!firstColor) {
+			mOut.push_back('$');
+		}
+		firstColor = false;
+		mOut.push_back('#');
+		appendNumber(mOut, r);
+
+		int end = width;
+		while (end > 0 && sixels[end - 1] == 0) {
+			end--;
+		}
+		for (int x = 0; x < end;) {
+			std::uint8_t bits = sixels[x];
+			int n = 1;
+			while (x + n < end && sixels[x + n] == bits) {
+				n++;
+			}
+			char c = static_cast<char>('?' + bits);
+			if (n >= SIXEL_REPEAT_MIN) {
+				mOut.push_back('!');
+				appendNumber(mOut, n);
+				mOut.push_back(c);
+			}
+			else {
+				mOut.insert(mOut.end(), n, c);
+			}
+			x += n;
+		}
+		std::memset(sixels, 0, end);
+	}
+	mOut.push_back('-');
+}
+
+void GraphicsPresenter::beginKitty()
+{
+	mPending.clear();
+	mFirstChunk = true;
+}
+
+void GraphicsPresenter::encodeKitty(const Rgb *colors, size_t count, int width, int height)
+{
+	const std::uint8_t *bytes = &colors[0].r;
+	size_t size = count * 3;
+
+	// Complete a chunk started by the previous row of tiles:
+	if (!mPending.empty()) {
+		size_t take = std::min(size, KITTY_CHUNK - mPending.size());
+		mPending.insert(mPending.end(), bytes, bytes + take);
+		bytes += take;
+		size -= take;
+		if (mPending.size() < KITTY_CHUNK) {
+			return;
+		}
+		appendKittyChunk(mPending.data(), KITTY_CHUNK, true, width, height);
+		mPending.clear();
+	}
+
+	for (; size >= KITTY_CHUNK; bytes += KITTY_CHUNK, size -= KITTY_CHUNK) {
+		appendKittyChunk(bytes, KITTY_CHUNK, true, width, height);
+	}
+	mPending.assign(bytes, bytes + size);
+}
+
+void GraphicsPresenter::appendKittyChunk(const std::uint8_t *data, size_t size, bool more, int width, int height)
+{
+	mOut.insert(mOut.end(), { '\x1b', '_', 'G' });
+	if (mFirstChunk) {
+		// 24-bit RGB, replacing the previous frame's image and placement without replies:
+		static const char KEYS[] = "a=T,f=24,i=1,p=1,q=2,s=";
+		mOut.insert(mOut.end(), KEYS, KEYS + sizeof(KEYS) - 1);
+		appendNumber(mOut, width);
+		mOut.insert(mOut.end(), { ',', 'v', '=' });
+		appendNumber(mOut, height);
+		mOut.push_back(',');
+		mFirstChunk = false;
+	}
+	mOut.insert(mOut.end(), { 'm', '=', more ? '1' : '0', ';' });
+
+	size_t offset = mOut.size();
+	mOut.resize(offset + (size + 2) / 3 * 4);
+	char *out = &mOut[offset];
+	size_t i = 0;
+	for (; i + 3 <= size; i += 3, out += 4) {
+		std::uint32_t v = data[i] << 16 | data[i + 1] << 8 | data[i + 2];
+		out[0] = BASE64[v >> 18];
+		out[1] = BASE64[v >> 12 & 0x3f];
+		out[2] = BASE64[v >> 6 & 0x3f];
+		out[3] = BASE64[v & 0x3f];
+	}
+	if (i < size) {
+		std::uint32_t v = data[i] << 16 | (i + 1 < size ? data[i + 1] << 8 : 0);
+		out[0] = BASE64[v >> 18];
+		out[1] = BASE64[v >> 12 & 0x3f];
+		out[2] = i + 1 < size ? BASE64[v >> 6 & 0x3f] : '=';
+		out[3] = '=';
+	}
+
+	mOut.insert(mOut.end(), { '\x1b', '\\' });
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Palette.h"
+#include "Renderer.h"
+
+/**
+ * Presents frames as images on terminals with a graphics protocol, Sixel
+ * or Kitty's, at one screen pixel per pixel.
+ *
+ * A frame is encoded while it is rendered: as soon as a row of tiles is
+ * done, it is colorized, encoded and written, so encoding and transfer
+ * overlap the computation of the rows below. Kitty images are sent as
+ * chunks of base64 RGB data, which the terminal decodes as they arrive.
+ * Sixel colors are registers set up from the palette's lookup table, so
+ * coloring a pixel is still one table lookup.
+ *
+ * As in the FramePipeline, pixels are colored by iteration count, without
+ * histogram equalization. The image is drawn at the cursor, which is left
+ * on the line below it.
+ */
+class GraphicsPresenter
+{
+
+public:
+
+	enum class Protocol {
+		SIXEL,
+		KITTY
+	};
+
+	struct Stats
+	{
+		size_t bytes = 0;
+		// Time spent colorizing and encoding, and in total:
+		double encodeSeconds = 0;
+		double frameSeconds = 0;
+	};
+
+private:
+
+	// Sixel registers, at most 256:
+	static const int REGISTERS = 256;
+
+	Protocol mProtocol;
+	int mFd;
+
+	std::vector<char> mOut;
+
+	// Sixel: register of each iteration count, and the registers of the frame:
+	std::vector<std::uint8_t> mRegisterLut;
+	std::vector<Rgb> mRegisterColors;
+	std::vector<std::uint8_t> mRegisters;
+
+	// Sixel: the dots of one band for each register, and which registers it uses:
+	std::vector<std::uint8_t> mSixels;
+	std::uint8_t mUsed[REGISTERS];
+
+	// Kitty: the colors of a row of tiles, and RGB bytes not sent yet:
+	std::vector<Rgb> mColors;
+	std::vector<std::uint8_t> mPending;
+	bool mFirstChunk = true;
+
+	Stats mStats;
+
+	/**
+	 * Assigns a register to every color of the palette's lookup table.
+	 */
+	void buildRegisters(const Palette &palette, int maxIterations);
+
+	void beginSixel(int width, int height);
+
+	/**
+	 * Encodes the six pixel rows from `y` as one sixel band.
+	 */
+	void encodeBand(int width, int height, int y);
+
+	void beginKitty();
+
+	/**
+	 * Appends RGB bytes, sending every complete chunk.
+	 */
+	void encodeKitty(const Rgb *colors, size_t count, int width, int height);
+
+	/**
+	 * Sends `size` bytes as one chunk, the last one unless `more`.
+	 */
+	void appendKittyChunk(const std::uint8_t *data, size_t size, bool more, int width, int height);
+
+	void flush();
+
+public:
+
+	/**
+	 * Writes to the given file descriptor, stdout by default.
+	 */
+	explicit GraphicsPresenter(Protocol protocol, int fd = 1);
+
+	/**
+	 * Renders `request` with `renderer` and streams it to the terminal,
+	 * returning once the whole image has been written.
+	 */
+	void present(Renderer &renderer, const RenderRequest &request, Palette &palette);
+
+	/**
+	 * Statistics of the last frame.
+	 */
+	inline const Stats &stats() const {
+		return mStats;
+	}
+
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * FNV-1a, the hash behind the keys of the tile and disk caches and the
+ * checksums of disk cache entries.
+ */
+static const std::uint64_t FNV_OFFSET = 14695981039346656037ull;
+static const std::uint64_t FNV_PRIME = 1099511628211ull;
+
+/**
+ * Folds the bytes of `value` into an FNV-1a hash.
+ */
+template<class T>
+inline void mix(std::uint64_t &hash, const T &value)
+{
+	unsigned char bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	for (unsigned char b : bytes) {
+		hash = (hash ^ b) * FNV_PRIME;
+	}
+}
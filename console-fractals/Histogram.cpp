@@ -0,0 +1,89 @@
+#include "Histogram.h"
+#include <algorithm>
+
+void HistogramEqualizer::equalize(ThreadPool &pool, const int *iterations, const float *smooth, size_t count, int maxIterations, float *out)
+{
+	const int workers = pool.size();
+	const size_t bins = static_cast<size_t>(maxIterations) + 1;
+
+	mWorkerBins.resize(workers);
+	for (auto &workerBins : mWorkerBins) {
+		workerBins.resize(bins);
+	}
+	mHistogram.resize(bins);
+	mCdf.resize(bins);
+
+	// Pixels and bins are split into a few chunks per worker for balance:
+	const int tasks = workers * 4;
+	auto range = [tasks](size_t size, int task, size_t &begin, size_t &end) {
+		begin = size * task / tasks;
+		end = size * (task + 1) / tasks;
+	};
+
+	pool.run(tasks, [&](int task, int) {
+		size_t begin, end;
+		range(bins, task, begin, end);
+		for (auto &workerBins : mWorkerBins) {
+			std::fill(workerBins.begin() + begin, workerBins.begin() + end, 0);
+		}
+	});
+
+	pool.run(tasks, [&](int task, int worker) {
+		size_t begin, end;
+		range(count, task, begin, end);
+		std::uint32_t *workerBins = mWorkerBins[worker].data();
+		for (size_t i = begin; i < end; i++) {
+			workerBins[std::min(iterations[i], maxIterations)]++;
+		}
+	});
+
+	// Merge the worker bins and sum up each chunk of the histogram:
+	std::vector<std::uint64_t> chunkSums(tasks);
+	pool.run(tasks, [&](int task, int) {
+		size_t begin, end;
+		range(bins, task, begin, end);
+		std::uint64_t sum = 0;
+		for (size_t b = begin; b < end; b++) {
+			std::uint64_t total = 0;
+			for (auto &workerBins : mWorkerBins) {
+				total += workerBins[b];
+			}
+			// Inside pixels don't take part in the equalization:
+			mHistogram[b] = b < static_cast<size_t>(maxIterations) ? total : 0;
+			sum += mHistogram[b];
+		}
+		chunkSums[task] = sum;
+	});
+
+	std::vector<std::uint64_t> chunkOffsets(tasks);
+	std::uint64_t escaped = 0;
+	for (int task = 0; task < tasks; task++) {
+		chunkOffsets[task] = escaped;
+		escaped += chunkSums[task];
+	}
+
+	pool.run(tasks, [&](int task, int) {
+		size_t begin, end;
+		range(bins, task, begin, end);
+		std::uint64_t sum = chunkOffsets[task];
+		for (size_t b = begin; b < end; b++) {
+			mCdf[b] = sum;
+			sum += mHistogram[b];
+		}
+	});
+
+	const float scale = escaped > 0 ? 1.0f / escaped : 0.0f;
+	pool.run(tasks, [&](int task, int) {
+		size_t begin, end;
+		range(count, task, begin, end);
+		for (size_t i = begin; i < end; i++) {
+			int n = iterations[i];
+			if (n >= maxIterations) {
+				out[i] = -1;
+				continue;
+			}
+			float fraction = smooth ? std::max(0.0f, std::min(1.0f, smooth[i] - n)) : 0.0f;
+			out[i] = (mCdf[n] + fraction * mHistogram[n]) * scale;
+		}
+	});
+}
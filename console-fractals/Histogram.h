@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ThreadPool.h"
+
+/**
+ * Histogram equalization of escape iteration counts.
+ *
+ * Maps every escaped pixel to its rank among all escaped pixels, so the
+ * palette is spread evenly over the pixels shown regardless of zoom depth.
+ * The histogram is counted into per-thread bins merged at the end, and the
+ * CDF is a parallel prefix sum over the bins, so the pass scales with the
+ * pool like the render itself.
+ */
+class HistogramEqualizer
+{
+
+private:
+
+	// Per-worker bins, merged into mHistogram:
+	std::vector<std::vector<std::uint32_t>> mWorkerBins;
+	std::vector<std::uint64_t> mHistogram;
+
+	// Number of escaped pixels with fewer iterations than the bin index:
+	std::vector<std::uint64_t> mCdf;
+
+public:
+
+	/**
+	 * Writes the equalized value in [0, 1] of each escaped pixel to `out`,
+	 * and -1 for pixels inside the set. If `smooth` is not null, the
+	 * normalized iteration counts interpolate within a bin, which removes
+	 * the banding of plain iteration counts.
+	 */
+	void equalize(ThreadPool &pool, const int *iterations, const float *smooth, size_t count, int maxIterations, float *out);
+
+	inline const std::vector<std::uint64_t> &histogram() const {
+		return mHistogram;
+	}
+
+};
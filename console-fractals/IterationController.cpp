@@ -0,0 +1,51 @@
+#include "IterationController.h"
+#include <algorithm>
+#include <cstdio>
+
+IterationDecision IterationController::decide(int current, const int *iterations, int count) const
+{
+	IterationDecision decision;
+	decision.maxIterations = current;
+	decision.liveFraction = 0;
+	decision.lateFraction = 0;
+	decision.maxEscape = 0;
+
+	if (count == 0) {
+		decision.reason = "no samples";
+		return decision;
+	}
+
+	int live = 0;
+	int late = 0;
+	for (int i = 0; i < count; i++) {
+		int n = iterations[i];
+		if (n >= current) {
+			live++;
+		}
+		else {
+			late += n >= current / 2 ? 1 : 0;
+			decision.maxEscape = std::max(decision.maxEscape, n);
+		}
+	}
+
+	int escaped = count - live;
+	decision.liveFraction = static_cast<double>(live) / count;
+	decision.lateFraction = escaped > 0 ? static_cast<double>(late) / escaped : 0;
+
+	char reason[160];
+	if (live > 0 && decision.lateFraction > mRaiseThreshold) {
+		decision.maxIterations = std::min(mMaxIterations, current * 2);
+		std::snprintf(reason, sizeof(reason), "raised: %.1f%% of escapes are in the upper half of the cap",
+			decision.lateFraction * 100);
+	}
+	else if (decision.maxEscape < current * mLowerRatio) {
+		decision.maxIterations = std::max(mMinIterations, decision.maxEscape * 4);
+		std::snprintf(reason, sizeof(reason), "lowered: nothing escapes after iteration %d", decision.maxEscape);
+	}
+	else {
+		std::snprintf(reason, sizeof(reason), "kept: %.1f%% of escapes are late", decision.lateFraction * 100);
+	}
+	decision.maxIterations = std::max(mMinIterations, std::min(mMaxIterations, decision.maxIterations));
+	decision.reason = reason;
+	return decision;
+}
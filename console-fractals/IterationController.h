@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+
+/**
+ * The iteration cap chosen for a frame, together with the escape statistics
+ * that justify it.
+ */
+struct IterationDecision
+{
+	int maxIterations;
+
+	// Fraction of samples which did not escape within the old cap:
+	double liveFraction;
+
+	// Fraction of the escaped samples which escaped in the upper half of the
+	// old cap, i.e. detail which a lower cap would have lost:
+	double lateFraction;
+
+	// Highest iteration count at which any sample escaped:
+	int maxEscape;
+
+	std::string reason;
+};
+
+/**
+ * Chooses the maximum iteration count from the escape-count distribution of
+ * a render or a sparse pre-pass.
+ *
+ * Many late escapes mean the cap cuts off detail, so it is raised. If the
+ * latest escape is far below the cap, the remaining live pixels are inside
+ * the set and every iteration beyond that is wasted, so it is lowered.
+ */
+class IterationController
+{
+
+private:
+
+	int mMinIterations = 16;
+	int mMaxIterations = 1 << 20;
+	double mRaiseThreshold = 0.01;
+	double mLowerRatio = 0.25;
+
+public:
+
+	inline void setLimits(int minIterations, int maxIterations) {
+		mMinIterations = minIterations;
+		mMaxIterations = maxIterations;
+	}
+
+	/**
+	 * Raise the cap if more than this fraction of escaped samples escape late.
+	 */
+	inline void setRaiseThreshold(double raiseThreshold) {
+		mRaiseThreshold = raiseThreshold;
+	}
+
+	/**
+	 * Lower the cap if the latest escape is below this fraction of it.
+	 */
+	inline void setLowerRatio(double lowerRatio) {
+		mLowerRatio = lowerRatio;
+	}
+
+	/**
+	 * Decides the next cap from `count` iteration counts computed with the
+	 * cap `current`.
+	 */
+	IterationDecision decide(int current, const int *iterations, int count) const;
+
+};
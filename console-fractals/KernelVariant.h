@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Kernels.h"
+
+/**
+ * Fills a KernelTable with every kernel instantiated for the instruction
+ * set of the including translation unit. Only the KernelsXXX.cpp files
+ * include this.
+ */
+namespace kernels {
+namespace {
+
+template<class Real, unsigned CHANNELS>
+inline void fillEscape(EscapeKernel (&kernels)[FORMULA_COUNT])
+{
+	kernels[static_cast<int>(Formula::MANDELBROT)] = &escape::escapeSpan<Real, Formula::MANDELBROT, CHANNELS>;
+	kernels[static_cast<int>(Formula::MULTIBROT3)] = &escape::escapeSpan<Real, Formula::MULTIBROT3, CHANNELS>;
+	kernels[static_cast<int>(Formula::MULTIBROT4)] = &escape::escapeSpan<Real, Formula::MULTIBROT4, CHANNELS>;
+	kernels[static_cast<int>(Formula::MULTIBROT5)] = &escape::escapeSpan<Real, Formula::MULTIBROT5, CHANNELS>;
+	kernels[static_cast<int>(Formula::TRICORN)] = &escape::escapeSpan<Real, Formula::TRICORN, CHANNELS>;
+	kernels[static_cast<int>(Formula::BURNING_SHIP)] = &escape::escapeSpan<Real, Formula::BURNING_SHIP, CHANNELS>;
+}
+
+inline KernelTable makeTable(Isa isa, const char *name)
+{
+	KernelTable table;
+	table.isa = isa;
+	table.name = name;
+	fillEscape<float, CHANNELS_BASIC>(table.escapeFloat[0]);
+	fillEscape<float, CHANNELS_SMOOTH>(table.escapeFloat[1]);
+	fillEscape<float, CHANNELS_ALL>(table.escapeFloat[2]);
+	fillEscape<double, CHANNELS_BASIC>(table.escapeDouble[0]);
+	fillEscape<double, CHANNELS_SMOOTH>(table.escapeDouble[1]);
+	fillEscape<double, CHANNELS_ALL>(table.escapeDouble[2]);
+	return table;
+}
+
+}
+}
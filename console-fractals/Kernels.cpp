@@ -0,0 +1,138 @@
+#include "Kernels.h"
+#include <cstring>
+
+#if defined(FRACTALS_X86_DISPATCH) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#ifdef FRACTALS_X86_DISPATCH
+
+#ifdef _MSC_VER
+
+struct CpuFeatures
+{
+	bool avx2 = false;
+	bool fma = false;
+	bool avx512 = false;
+
+	CpuFeatures()
+	{
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return;
+		}
+
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		fma = (info[2] & (1 << 12)) != 0;
+		if (!osxsave) {
+			return;
+		}
+
+		// The OS has to save the YMM and ZMM registers on context switches:
+		unsigned long long xcr0 = _xgetbv(0);
+		bool ymm = (xcr0 & 0x6) == 0x6;
+		bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+		__cpuidex(info, 7, 0);
+		avx2 = ymm && (info[1] & (1 << 5)) != 0;
+		avx512 = zmm && (info[1] & (1 << 16)) != 0;
+	}
+};
+
+#else
+
+struct CpuFeatures
+{
+	bool avx2;
+	bool fma;
+	bool avx512;
+
+	CpuFeatures()
+	{
+		__builtin_cpu_init();
+		avx2 = __builtin_cpu_supports("avx2") != 0;
+		fma = __builtin_cpu_supports("fma") != 0;
+		avx512 = __builtin_cpu_supports("avx512f") != 0;
+	}
+};
+
+#endif
+
+const CpuFeatures &cpuFeatures()
+{
+	static const CpuFeatures features;
+	return features;
+}
+
+#endif
+
+}
+
+bool kernels::supported(Isa isa)
+{
+	switch (isa) {
+	case Isa::BASELINE:
+		return true;
+#ifdef FRACTALS_X86_DISPATCH
+	case Isa::AVX2:
+		return cpuFeatures().avx2 && cpuFeatures().fma;
+	case Isa::AVX512:
+		return cpuFeatures().avx512 && cpuFeatures().avx2 && cpuFeatures().fma;
+#endif
+	default:
+		return false;
+	}
+}
+
+const KernelTable &kernels::best()
+{
+#ifdef FRACTALS_X86_DISPATCH
+	if (supported(Isa::AVX512)) {
+		return avx512();
+	}
+	if (supported(Isa::AVX2)) {
+		return avx2();
+	}
+#endif
+	return baseline();
+}
+
+const KernelTable &kernels::select(Isa isa)
+{
+	if (!supported(isa)) {
+		return best();
+	}
+
+	switch (isa) {
+#ifdef FRACTALS_X86_DISPATCH
+	case Isa::AVX2:
+		return avx2();
+	case Isa::AVX512:
+		return avx512();
+#endif
+	default:
+		return baseline();
+	}
+}
+
+bool kernels::parseIsa(const char *name, Isa &isa)
+{
+	if (std::strcmp(name, "baseline") == 0) {
+		isa = Isa::BASELINE;
+	}
+	else if (std::strcmp(name, "avx2") == 0) {
+		isa = Isa::AVX2;
+	}
+	else if (std::strcmp(name, "avx512") == 0) {
+		isa = Isa::AVX512;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Escape.h"
+
+enum class Precision {
+	FLOAT,
+	DOUBLE
+};
+
+/**
+ * Instruction set a kernel table has been compiled for.
+ */
+enum class Isa {
+	BASELINE,
+	AVX2,
+	AVX512
+};
+
+/**
+ * Computes the escape iteration counts of `count` points, and whichever
+ * other channels the kernel was compiled for and `out` has buffers for.
+ */
+using EscapeKernel = void (*)(const EscapeParams &params, const double *x, const double *y, int count, const GBufferSpan &out);
+
+/**
+ * The hot kernels of one compiled variant. Each variant lives in its own
+ * translation unit, built with the target flags of its instruction set.
+ */
+struct KernelTable
+{
+	Isa isa;
+	const char *name;
+	// Indexed by channel preset and formula:
+	EscapeKernel escapeFloat[CHANNEL_PRESET_COUNT][FORMULA_COUNT];
+	EscapeKernel escapeDouble[CHANNEL_PRESET_COUNT][FORMULA_COUNT];
+
+	/**
+	 * The cheapest kernel producing at least `channels`.
+	 */
+	inline EscapeKernel escape(Precision precision, Formula formula, unsigned channels = CHANNELS_BASIC) const {
+		int preset = channelPreset(channels);
+		int i = static_cast<int>(formula);
+		return precision == Precision::FLOAT ? escapeFloat[preset][i] : escapeDouble[preset][i];
+	}
+};
+
+namespace kernels {
+
+const KernelTable &baseline();
+
+#ifdef FRACTALS_X86_DISPATCH
+const KernelTable &avx2();
+
+const KernelTable &avx512();
+#endif
+
+/**
+ * Whether the running CPU can execute kernels of the given instruction set.
+ */
+bool supported(Isa isa);
+
+/**
+ * The best variant the running CPU supports.
+ */
+const KernelTable &best();
+
+/**
+ * The requested variant, or the best supported one if the CPU lacks it.
+ */
+const KernelTable &select(Isa isa);
+
+/**
+ * Parses "baseline", "avx2" or "avx512". Returns false for unknown names.
+ */
+bool parseIsa(const char *name, Isa &isa);
+
+}
@@ -0,0 +1,11 @@
+#include "KernelVariant.h"
+
+#ifndef __AVX2__
+#error "KernelsAVX2.cpp must be compiled with AVX2 enabled"
+#endif
+
+const KernelTable &kernels::avx2()
+{
+	static const KernelTable table = makeTable(Isa::AVX2, "avx2+fma");
+	return table;
+}
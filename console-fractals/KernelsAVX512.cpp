@@ -0,0 +1,11 @@
+#include "KernelVariant.h"
+
+#ifndef __AVX512F__
+#error "KernelsAVX512.cpp must be compiled with AVX-512 enabled"
+#endif
+
+const KernelTable &kernels::avx512()
+{
+	static const KernelTable table = makeTable(Isa::AVX512, "avx512");
+	return table;
+}
@@ -0,0 +1,7 @@
+#include "KernelVariant.h"
+
+const KernelTable &kernels::baseline()
+{
+	static const KernelTable table = makeTable(Isa::BASELINE, "baseline");
+	return table;
+}
@@ -0,0 +1,113 @@
+#include "Keyboard.h"
+#include <chrono>
+
+#ifdef _WIN32
+#include <conio.h>
+#else
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+// How often the reader thread checks whether it should stop:
+static const int POLL_MILLISECONDS = 50;
+
+#ifndef _WIN32
+// Terminal settings to restore, as only one keyboard reads the terminal:
+static termios sSavedTermios;
+static bool sRawMode = false;
+#endif
+
+Keyboard::Keyboard()
+	: mEvents(QUEUE_CAPACITY)
+{
+#ifndef _WIN32
+	if (tcgetattr(STDIN_FILENO, &sSavedTermios) == 0) {
+		termios raw = sSavedTermios;
+		raw.c_lflag &= ~(ICANON | ECHO | ISIG);
+		raw.c_cc[VMIN] = 1;
+		raw.c_cc[VTIME] = 0;
+		sRawMode = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+	}
+#endif
+	mThread = std::thread(&Keyboard::read, this);
+}
+
+Keyboard::~Keyboard()
+{
+	mStopping = true;
+	mThread.join();
+#ifndef _WIN32
+	if (sRawMode) {
+		tcsetattr(STDIN_FILENO, TCSANOW, &sSavedTermios);
+		sRawMode = false;
+	}
+#endif
+}
+
+void Keyboard::read()
+{
+	auto push = [this](Key key, char character) {
+		// Keys beyond a full queue are dropped, the user is far ahead of the display:
+		mEvents.tryPush({ key, character });
+	};
+
+	while (!mStopping) {
+#ifdef _WIN32
+		if (!_kbhit()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MILLISECONDS));
+			continue;
+		}
+		int c = _getch();
+		if (c == 0 || c == 224) {
+			switch (_getch()) {
+			case 72: push(Key::UP, 0); break;
+			case 80: push(Key::DOWN, 0); break;
+			case 75: push(Key::LEFT, 0); break;
+			case 77: push(Key::RIGHT, 0); break;
+			}
+		}
+		else if (c == 27) {
+			push(Key::ESCAPE, 0);
+		}
+		else {
+			push(Key::CHARACTER, static_cast<char>(c));
+		}
+#else
+		pollfd input{ STDIN_FILENO, POLLIN, 0 };
+		int ready = ::poll(&input, 1, POLL_MILLISECONDS);
+		if (ready <= 0) {
+			continue;
+		}
+		char buffer[64];
+		ssize_t count = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+		if (count <= 0) {
+			// End of input, e.g. a closed pipe:
+			if (count == 0) {
+				push(Key::ESCAPE, 0);
+				return;
+			}
+			continue;
+		}
+
+		// Arrow keys arrive as CSI or SS3 sequences, ESC [ A or ESC O A:
+		for (ssize_t i = 0; i < count; i++) {
+			if (buffer[i] != '\x1b') {
+				push(Key::CHARACTER, buffer[i]);
+				continue;
+			}
+			if (i + 2 < count && (buffer[i + 1] == '[' || buffer[i + 1] == 'O')) {
+				switch (buffer[i + 2]) {
+				case 'A': push(Key::UP, 0); break;
+				case 'B': push(Key::DOWN, 0); break;
+				case 'C': push(Key::RIGHT, 0); break;
+				case 'D': push(Key::LEFT, 0); break;
+				}
+				i += 2;
+				continue;
+			}
+			push(Key::ESCAPE, 0);
+		}
+#endif
+	}
+}
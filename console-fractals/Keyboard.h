@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include "BoundedQueue.h"
+
+enum class Key {
+	CHARACTER,
+	UP,
+	DOWN,
+	LEFT,
+	RIGHT,
+	ESCAPE
+};
+
+struct KeyEvent
+{
+	Key key;
+	// The character typed, for Key::CHARACTER:
+	char character;
+};
+
+/**
+ * Reads the keyboard on its own thread, with the terminal in raw mode so
+ * keys arrive as they are pressed, without echo or line editing.
+ *
+ * Events are queued without blocking either side, and taken with poll().
+ * Ctrl-C arrives as the character 3 instead of a signal, so the terminal
+ * is always restored when the keyboard is destroyed.
+ */
+class Keyboard
+{
+
+private:
+
+	static const size_t QUEUE_CAPACITY = 64;
+
+	BoundedQueue<KeyEvent> mEvents;
+	std::atomic<bool> mStopping{ false };
+	std::thread mThread;
+
+	void read();
+
+public:
+
+	Keyboard();
+
+	~Keyboard();
+
+	Keyboard(const Keyboard &) = delete;
+
+	Keyboard &operator=(const Keyboard &) = delete;
+
+	/**
+	 * Takes the next key pressed, or returns false if there is none.
+	 */
+	inline bool poll(KeyEvent &event) {
+		return mEvents.tryPop(event);
+	}
+
+};
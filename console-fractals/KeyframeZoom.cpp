@@ -0,0 +1,147 @@
+#include "KeyframeZoom.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+KeyframeZoom::KeyframeZoom(ThreadPool &pool, const RenderRequest &request, glm::dvec2 target, int framesPerOctave, DiskCache *cache)
+	: mPool(pool),
+	mRenderer(pool, cache),
+	mRequest(request),
+	mTarget(target),
+	mFramesPerOctave(framesPerOctave)
+{
+}
+
+RenderRequest KeyframeZoom::view(double zoom, int scale) const
+{
+	RenderRequest view = mRequest;
+	view.zoom = zoom;
+	// The target keeps its pixel, so its offset from the center shrinks with the zoom:
+	view.center = mTarget + (mRequest.center - mTarget) * (mRequest.zoom / zoom);
+	view.width *= scale;
+	view.height *= scale;
+	return view;
+}
+
+void KeyframeZoom::renderKeyframe(Keyframe &keyframe, int octave, Palette &palette)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	keyframe.octave = octave;
+	keyframe.request = view(mRequest.zoom * std::ldexp(1.0, octave), 2);
+	mRenderer.render(keyframe.request, mGBuffer);
+
+	keyframe.colors.resize(mGBuffer.size);
+	palette.build(mRequest.params.maxIterations);
+	palette.colorize(mGBuffer.iterations.data(), static_cast<int>(mGBuffer.size), keyframe.colors.data());
+
+	mStats.keyframes++;
+	mStats.renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void KeyframeZoom::map(const RenderRequest &frame, const Keyframe &keyframe)
+{
+	// The inverse of RenderRequest::planeX() and planeY() for the keyframe:
+	const RenderRequest &k = keyframe.request;
+	const double extent = 2 * RenderRequest::LOGIC_VIEWPORT_SIZE_MUL / k.zoom;
+
+	mColumns.resize(frame.width);
+	for (int x = 0; x < frame.width; x++) {
+		mColumns[x] = (frame.planeX(x) - k.center.x) / extent * k.width + k.width / 2;
+	}
+	mRows.resize(frame.height);
+	for (int y = 0; y < frame.height; y++) {
+		mRows[y] = k.height - k.height / 2 - (frame.planeY(y) - k.center.y) / extent * k.height;
+	}
+
+	// Taps a quarter of a pixel footprint on either side of the center, with the edges extended:
+	const double footprint = k.zoom / frame.zoom * k.width / frame.width;
+	auto tap = [](double x, int size) {
+		x = std::min(std::max(x, 0.0), size - 1.0);
+		int first = static_cast<int>(x);
+		return Tap{ first, std::min(first + 1, size - 1), static_cast<float>(x - first) };
+	};
+	mColumnTaps.resize(2 * mColumns.size());
+	for (size_t x = 0; x < mColumns.size(); x++) {
+		mColumnTaps[2 * x] = tap(mColumns[x] - footprint / 4, k.width);
+		mColumnTaps[2 * x + 1] = tap(mColumns[x] + footprint / 4, k.width);
+	}
+	mRowTaps.resize(2 * mRows.size());
+	for (size_t y = 0; y < mRows.size(); y++) {
+		mRowTaps[2 * y] = tap(mRows[y] - footprint / 4, k.height);
+		mRowTaps[2 * y + 1] = tap(mRows[y] + footprint / 4, k.height);
+	}
+}
+
+glm::vec3 KeyframeZoom::filter(const Keyframe &keyframe, int x, int y) const
+{
+	const Rgb *colors = keyframe.colors.data();
+	const size_t width = keyframe.request.width;
+	auto color = [&](int column, int row) {
+		const Rgb &c = colors[row * width + column];
+		return glm::vec3(c.r, c.g, c.b);
+	};
+
+	glm::vec3 sum(0);
+	for (int j = 0; j < 2; j++) {
+		const Tap &row = mRowTaps[2 * y + j];
+		for (int i = 0; i < 2; i++) {
+			const Tap &column = mColumnTaps[2 * x + i];
+			glm::vec3 top = glm::mix(color(column.first, row.first), color(column.second, row.first), column.weight);
+			glm::vec3 bottom = glm::mix(color(column.first, row.second), color(column.second, row.second), column.weight);
+			sum += glm::mix(top, bottom, row.weight);
+		}
+	}
+	return sum * 0.25f;
+}
+
+void KeyframeZoom::frame(int frame, Palette &palette, Rgb *out)
+{
+	const int octave = frame / mFramesPerOctave;
+	const double t = static_cast<double>(frame % mFramesPerOctave) / mFramesPerOctave;
+	const RenderRequest view = this->view(mRequest.zoom * std::pow(2.0, octave + t), 1);
+
+	Keyframe &below = mKeyframes[octave % 2];
+	Keyframe &above = mKeyframes[(octave + 1) % 2];
+	if (below.octave != octave) {
+		renderKeyframe(below, octave, palette);
+	}
+	if (t > 0 && above.octave != octave + 1) {
+		renderKeyframe(above, octave + 1, palette);
+	}
+
+	std::vector<glm::vec3> &pixels = mPixels;
+	pixels.resize(static_cast<size_t>(view.width) * view.height);
+	map(view, below);
+	mPool.run(view.height, [&](int y, int) {
+		for (int x = 0; x < view.width; x++) {
+			pixels[static_cast<size_t>(y) * view.width + x] = filter(below, x, y);
+		}
+	}, view.priority);
+
+	// Fades into the next keyframe where it covers the frame:
+	if (t > 0) {
+		map(view, above);
+		const float weight = static_cast<float>(t);
+		mPool.run(view.height, [&](int y, int) {
+			if (mRows[y] < 0 || mRows[y] > above.request.height - 1) {
+				return;
+			}
+			for (int x = 0; x < view.width; x++) {
+				if (mColumns[x] < 0 || mColumns[x] > above.request.width - 1) {
+					continue;
+				}
+				glm::vec3 &pixel = pixels[static_cast<size_t>(y) * view.width + x];
+				pixel = glm::mix(pixel, filter(above, x, y), weight);
+			}
+		}, view.priority);
+	}
+
+	for (size_t p = 0; p < pixels.size(); p++) {
+		out[p] = {
+			static_cast<std::uint8_t>(pixels[p].r + 0.5f),
+			static_cast<std::uint8_t>(pixels[p].g + 0.5f),
+			static_cast<std::uint8_t>(pixels[p].b + 0.5f)
+		};
+	}
+}
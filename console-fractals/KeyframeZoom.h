@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "Palette.h"
+#include "Renderer.h"
+#include "ThreadPool.h"
+
+/**
+ * Produces the frames of a zoom video from one rendered keyframe per
+ * octave of zoom.
+ *
+ * Keyframe k shows the view at zoom z0 * 2^k with twice the frame's
+ * resolution in both directions, so every frame up to the next octave is
+ * a part of it with at least one sample per pixel. A frame is scaled out
+ * of the keyframe below its zoom and, where the next keyframe covers it,
+ * cross-faded into that one as the zoom approaches it, so detail fades in
+ * instead of popping up at each octave.
+ *
+ * The zoom heads for `target`, which need not be the center of the first
+ * frame: the view pans so that the target stays at the same pixel, which
+ * a log-polar strip cannot follow. Only two keyframes are held at a time,
+ * and they are rendered as the frames reach them.
+ */
+class KeyframeZoom
+{
+
+public:
+
+	struct Stats
+	{
+		int keyframes = 0;
+		double renderSeconds = 0;
+	};
+
+private:
+
+	struct Keyframe
+	{
+		int octave = -1;
+		RenderRequest request;
+		std::vector<Rgb> colors;
+	};
+
+	/**
+	 * A linear interpolation between keyframe pixels `first` and `second`
+	 * along one axis, with `weight` on the second.
+	 */
+	struct Tap
+	{
+		int first;
+		int second;
+		float weight;
+	};
+
+	ThreadPool &mPool;
+	Renderer mRenderer;
+	RenderRequest mRequest;
+	glm::dvec2 mTarget;
+	int mFramesPerOctave;
+
+	Keyframe mKeyframes[2];
+	GBuffer mGBuffer;
+
+	// Keyframe coordinates of the columns and rows of a frame, and two taps for each:
+	std::vector<double> mColumns;
+	std::vector<double> mRows;
+	std::vector<Tap> mColumnTaps;
+	std::vector<Tap> mRowTaps;
+
+	std::vector<glm::vec3> mPixels;
+
+	Stats mStats;
+
+	/**
+	 * The view of the frame at `zoom`, at `scale` times the frame size.
+	 */
+	RenderRequest view(double zoom, int scale) const;
+
+	void renderKeyframe(Keyframe &keyframe, int octave, Palette &palette);
+
+	/**
+	 * Maps the pixel centers of `frame` to the pixel coordinates of
+	 * `keyframe` in mColumns and mRows, and their footprints to taps.
+	 */
+	void map(const RenderRequest &frame, const Keyframe &keyframe);
+
+	/**
+	 * The color of frame pixel (x, y) in `keyframe`, as last mapped: the
+	 * mean of four bilinear samples spread over the pixel's footprint.
+	 */
+	glm::vec3 filter(const Keyframe &keyframe, int x, int y) const;
+
+public:
+
+	/**
+	 * Zooms from the view of `request` towards `target`, doubling the zoom
+	 * every `framesPerOctave` frames, taking the keyframes `cache` has from
+	 * it if given.
+	 */
+	KeyframeZoom(ThreadPool &pool, const RenderRequest &request, glm::dvec2 target, int framesPerOctave, DiskCache *cache = nullptr);
+
+	/**
+	 * Produces frame `frame`, request.width x request.height colors, with
+	 * keyframes colored by `palette`. Frames are cheapest in order.
+	 */
+	void frame(int frame, Palette &palette, Rgb *out);
+
+	inline const Stats &stats() const {
+		return mStats;
+	}
+
+};
@@ -0,0 +1,92 @@
+#include "LogPolar.h"
+#include <algorithm>
+#include <cmath>
+
+static const double TAU = 6.283185307179586;
+
+// Distance of the frame corners from the center, in frame widths and heights:
+static const double CORNER = 0.7071067811865476;
+
+/**
+ * Width and height of the plane a frame at `zoom` shows, see RenderRequest.
+ */
+static double extent(double zoom)
+{
+	return 2 * RenderRequest::LOGIC_VIEWPORT_SIZE_MUL / zoom;
+}
+
+LogPolarZoom::LogPolarZoom(const RenderRequest &request, double finalZoom)
+	: mRequest(request)
+{
+	const int width = request.width;
+	const int height = request.height;
+	const int pixels = std::max(width, height);
+
+	mAngles = static_cast<int>(std::ceil(TAU * CORNER * pixels));
+	mStep = TAU / mAngles;
+
+	// From the corners of the first frame down to half a pixel of the last:
+	mOuterRadius = extent(request.zoom) * CORNER;
+	double innerRadius = extent(finalZoom) * 0.5 / pixels;
+	mRadii = static_cast<int>(std::ceil(std::log(mOuterRadius / innerRadius) / mStep)) + 1;
+
+	mColumn.resize(static_cast<size_t>(width) * height);
+	mRow.resize(mColumn.size());
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			double u = static_cast<double>(x - width / 2) / width;
+			double v = static_cast<double>((height - y) - height / 2) / height;
+			double radius = std::sqrt(u * u + v * v);
+			size_t p = static_cast<size_t>(y) * width + x;
+			int column = static_cast<int>(std::lround(std::atan2(v, u) / mStep));
+			mColumn[p] = (column % mAngles + mAngles) % mAngles;
+			// The center pixel maps past the last row:
+			mRow[p] = radius > 0 ? static_cast<float>(std::log(radius) / mStep) : -1e9f;
+		}
+	}
+}
+
+void LogPolarZoom::render(ThreadPool &pool)
+{
+	mStrip.resize(static_cast<size_t>(mAngles) * mRadii);
+	RenderJob::Kernel kernel = Renderer::kernel(mRequest);
+
+	std::vector<double> cosines(mAngles);
+	std::vector<double> sines(mAngles);
+	for (int i = 0; i < mAngles; i++) {
+		cosines[i] = std::cos(i * mStep);
+		sines[i] = std::sin(i * mStep);
+	}
+
+	std::vector<std::vector<double>> scratchX(pool.size());
+	std::vector<std::vector<double>> scratchY(pool.size());
+
+	pool.run(mRadii, [&](int row, int worker) {
+		const double radius = mOuterRadius * std::exp(-row * mStep);
+		std::vector<double> &x = scratchX[worker];
+		std::vector<double> &y = scratchY[worker];
+		x.resize(mAngles);
+		y.resize(mAngles);
+		for (int i = 0; i < mAngles; i++) {
+			x[i] = mRequest.center.x + radius * cosines[i];
+			y[i] = mRequest.center.y + radius * sines[i];
+		}
+		GBufferSpan span;
+		span.iterations = &mStrip[static_cast<size_t>(row) * mAngles];
+		kernel(x.data(), y.data(), mAngles, span);
+	}, mRequest.priority);
+}
+
+void LogPolarZoom::frame(double zoom, int *iterations) const
+{
+	// Row of a pixel is the offset less its log radius at zoom 1:
+	const float offset = static_cast<float>(std::log(mOuterRadius / extent(zoom)) / mStep) + 0.5f;
+	const float last = static_cast<float>(mRadii - 1);
+	const int *strip = mStrip.data();
+	const size_t count = mColumn.size();
+
+	for (size_t p = 0; p < count; p++) {
+		float row = std::min(std::max(offset - mRow[p], 0.0f), last);
+		iterations[p] = strip[static_cast<size_t>(row) * mAngles + mColumn[p]];
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include "Renderer.h"
+#include "ThreadPool.h"
+
+/**
+ * Renders a zoom into one point once, as a strip in log-polar coordinates,
+ * and reprojects every frame of the zoom from it.
+ *
+ * Each row of the strip is a circle around the zoom target, and the radii
+ * of consecutive rows shrink by a constant factor, chosen so that samples
+ * are as far apart along a row as across rows. With as many samples per
+ * row as the frame has pixels around its corners, every frame finds a
+ * sample at least as dense as its pixels at every radius. The strip costs
+ * in proportion to the logarithm of the zoom range rather than the number
+ * of frames, so long, smooth zooms become much cheaper than one render
+ * per frame.
+ *
+ * Frames take the nearest sample. Its row and column only depend on the
+ * zoom through an offset, so reprojecting a frame is one table lookup and
+ * one subtraction per pixel.
+ */
+class LogPolarZoom
+{
+
+private:
+
+	RenderRequest mRequest;
+
+	// Samples per row and rows of the strip, and the log radius step between rows:
+	int mAngles = 0;
+	int mRadii = 0;
+	double mStep = 0;
+
+	// Radius of the first row:
+	double mOuterRadius = 0;
+
+	// Iteration counts of the strip, row by row from the outside in:
+	std::vector<int> mStrip;
+
+	// Column and log radius (in rows) of every pixel of a frame at zoom 1:
+	std::vector<int> mColumn;
+	std::vector<float> mRow;
+
+public:
+
+	/**
+	 * Prepares a zoom into `request.center` from `request.zoom` to
+	 * `finalZoom`, for frames of the request's size.
+	 */
+	LogPolarZoom(const RenderRequest &request, double finalZoom);
+
+	/**
+	 * Computes the strip on `pool`, in the request's priority class.
+	 */
+	void render(ThreadPool &pool);
+
+	/**
+	 * Reprojects the frame at `zoom`, which must lie within the range the
+	 * zoom was prepared for, into `iterations` with one count per pixel.
+	 */
+	void frame(double zoom, int *iterations) const;
+
+	inline int angles() const {
+		return mAngles;
+	}
+
+	inline int radii() const {
+		return mRadii;
+	}
+
+};
@@ -0,0 +1,94 @@
+#include "Palette.h"
+#include <algorithm>
+
+Palette::Palette()
+	: mColors{
+		{ 255, 255, 255 },
+		{ 18, 35, 150 },
+		{ 248, 218, 82 },
+		{ 87, 14, 36 }
+	}
+{
+}
+
+void Palette::build(int maxIterations)
+{
+	if (maxIterations == mMaxIterations) {
+		return;
+	}
+	mMaxIterations = maxIterations;
+
+	mCharLut.resize(maxIterations + 1);
+	mColorLut.resize(maxIterations + 1);
+
+	int colorCount = static_cast<int>(mColors.size());
+	for (int n = 0; n < maxIterations; n++) {
+		mCharLut[n] = mRamp[n / mStretch % mRamp.size()];
+
+		// Same blend as the Vulkan viewer's fragment shader:
+		const Rgb &a = mColors[n / mStretch % colorCount];
+		const Rgb &b = mColors[(n / mStretch + 1) % colorCount];
+		int m = n % mStretch;
+		mColorLut[n] = {
+			static_cast<std::uint8_t>((a.r * (mStretch - m) + b.r * m) / mStretch),
+			static_cast<std::uint8_t>((a.g * (mStretch - m) + b.g * m) / mStretch),
+			static_cast<std::uint8_t>((a.b * (mStretch - m) + b.b * m) / mStretch)
+		};
+	}
+	mCharLut[maxIterations] = mInsideChar;
+	mColorLut[maxIterations] = mInsideColor;
+
+	// The equalized tables run through the ramp and the colors exactly once:
+	mEqualizedCharLut.resize(EQUALIZED_LUT_SIZE + 1);
+	mEqualizedColorLut.resize(EQUALIZED_LUT_SIZE + 1);
+	for (int i = 0; i <= EQUALIZED_LUT_SIZE; i++) {
+		double t = static_cast<double>(i) / EQUALIZED_LUT_SIZE;
+		size_t r = std::min(mRamp.size() - 1, static_cast<size_t>(t * mRamp.size()));
+		mEqualizedCharLut[i] = mRamp[r];
+
+		double position = t * (colorCount - 1);
+		int c = std::max(0, std::min(colorCount - 2, static_cast<int>(position)));
+		double m = std::min(1.0, position - c);
+		const Rgb &a = mColors[c];
+		const Rgb &b = mColors[std::min(c + 1, colorCount - 1)];
+		mEqualizedColorLut[i] = {
+			static_cast<std::uint8_t>(a.r + (b.r - a.r) * m),
+			static_cast<std::uint8_t>(a.g + (b.g - a.g) * m),
+			static_cast<std::uint8_t>(a.b + (b.b - a.b) * m)
+		};
+	}
+}
+
+void Palette::colorize(const int *iterations, int count, char *out) const
+{
+	const char *lut = mCharLut.data();
+	int last = mMaxIterations;
+	for (int i = 0; i < count; i++) {
+		out[i] = lut[std::min(iterations[i], last)];
+	}
+}
+
+void Palette::colorize(const int *iterations, int count, Rgb *out) const
+{
+	const Rgb *lut = mColorLut.data();
+	int last = mMaxIterations;
+	for (int i = 0; i < count; i++) {
+		out[i] = lut[std::min(iterations[i], last)];
+	}
+}
+
+void Palette::colorizeEqualized(const float *values, int count, char *out) const
+{
+	const char *lut = mEqualizedCharLut.data();
+	for (int i = 0; i < count; i++) {
+		out[i] = values[i] < 0 ? mInsideChar : lut[static_cast<int>(std::min(values[i], 1.0f) * EQUALIZED_LUT_SIZE)];
+	}
+}
+
+void Palette::colorizeEqualized(const float *values, int count, Rgb *out) const
+{
+	const Rgb *lut = mEqualizedColorLut.data();
+	for (int i = 0; i < count; i++) {
+		out[i] = values[i] < 0 ? mInsideColor : lut[static_cast<int>(std::min(values[i], 1.0f) * EQUALIZED_LUT_SIZE)];
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Rgb
+{
+	std::uint8_t r;
+	std::uint8_t g;
+	std::uint8_t b;
+};
+
+/**
+ * Maps iteration counts to characters and colors.
+ *
+ * Both mappings are precomputed into lookup tables indexed by the iteration
+ * count, so recoloring a frame is one table lookup per pixel and never
+ * touches the escape kernels.
+ */
+class Palette
+{
+
+private:
+
+	// Characters for escaped pixels, cycled every mStretch iterations:
+	std::string mRamp = " ";
+	char mInsideChar = '+';
+
+	// Colors for escaped pixels, blended over mStretch iterations each:
+	std::vector<Rgb> mColors;
+	Rgb mInsideColor{ 0, 0, 0 };
+	int mStretch = 5;
+
+	static const int EQUALIZED_LUT_SIZE = 1024;
+
+	int mMaxIterations = -1;
+	std::vector<char> mCharLut;
+	std::vector<Rgb> mColorLut;
+
+	// Spread over [0, 1] once for equalized values:
+	std::vector<char> mEqualizedCharLut;
+	std::vector<Rgb> mEqualizedColorLut;
+
+public:
+
+	Palette();
+
+	inline void setRamp(const std::string &ramp, char insideChar) {
+		mRamp = ramp.empty() ? " " : ramp;
+		mInsideChar = insideChar;
+		mMaxIterations = -1;
+	}
+
+	inline void setColors(const std::vector<Rgb> &colors, Rgb insideColor, int stretch) {
+		mColors = colors;
+		mInsideColor = insideColor;
+		mStretch = stretch > 0 ? stretch : 1;
+		mMaxIterations = -1;
+	}
+
+	inline const std::string &ramp() const {
+		return mRamp;
+	}
+
+	inline Rgb insideColor() const {
+		return mInsideColor;
+	}
+
+	/**
+	 * Rebuilds the lookup tables if the palette or the cap has changed.
+	 * Pixels with maxIterations iterations are inside the set.
+	 */
+	void build(int maxIterations);
+
+	void colorize(const int *iterations, int count, char *out) const;
+
+	void colorize(const int *iterations, int count, Rgb *out) const;
+
+	/**
+	 * Colors values in [0, 1] as produced by the HistogramEqualizer.
+	 * Negative values are inside the set.
+	 */
+	void colorizeEqualized(const float *values, int count, char *out) const;
+
+	void colorizeEqualized(const float *values, int count, Rgb *out) const;
+
+};
@@ -0,0 +1,175 @@
+#include "RenderJob.h"
+#include <algorithm>
+
+// Out-of-line definition, as std::min() takes TILE_SIZE by reference:
+const int RenderJob::TILE_SIZE;
+
+RenderJob::RenderJob(int width, int height, unsigned channels, std::vector<double> columnX, std::vector<double> rowY,
+	Kernel kernel, std::vector<Tile> tiles, std::vector<std::uint8_t> skip)
+	: mWidth(width),
+	mKernel(std::move(kernel)),
+	mColumnX(std::move(columnX)),
+	mRowY(std::move(rowY)),
+	mTiles(std::move(tiles)),
+	mTileDone(new std::atomic<bool>[mTiles.size()]),
+	mSkip(std::move(skip)),
+	mStatus(mPromise.get_future().share())
+{
+	for (size_t t = 0; t < mTiles.size(); t++) {
+		mTileDone[t] = false;
+	}
+	mGBuffer.resize(static_cast<size_t>(width) * height, channels);
+}
+
+RenderJob::~RenderJob()
+{
+	cancel();
+	if (mThread.joinable()) {
+		mThread.join();
+	}
+}
+
+void RenderJob::start(ThreadPool &pool, std::chrono::steady_clock::time_point deadline, ThreadPool::Priority priority)
+{
+	mToken.setDeadline(deadline);
+	mScratchX.resize(pool.size());
+	mScratchY.resize(pool.size());
+	if (!mSkip.empty()) {
+		mScratchColumns.resize(pool.size());
+		mScratch.resize(pool.size());
+	}
+
+	mThread = std::thread([this, &pool, priority]() {
+		pool.run(tileCount(), [this](int tile, int worker) {
+			renderTile(tile, worker);
+		}, priority);
+
+		if (mTilesDone == tileCount()) {
+			mPromise.set_value(RenderStatus::COMPLETE);
+		}
+		else {
+			mPromise.set_value(mToken.cancelRequested() ? RenderStatus::CANCELLED : RenderStatus::EXPIRED);
+		}
+	});
+}
+
+void RenderJob::renderTile(int tile, int worker)
+{
+	if (mToken.stopped()) {
+		return;
+	}
+
+	const Tile &t = mTiles[tile];
+	std::vector<double> &x = mScratchX[worker];
+	std::vector<double> &y = mScratchY[worker];
+
+	if (mSkip.empty()) {
+		x.assign(mColumnX.begin() + t.x, mColumnX.begin() + t.x + t.width);
+		y.resize(t.width);
+		for (int row = t.y; row < t.y + t.height; row++) {
+			std::fill(y.begin(), y.end(), mRowY[row]);
+			mKernel(x.data(), y.data(), t.width, mGBuffer.span(static_cast<size_t>(row) * mWidth + t.x));
+		}
+	}
+	else {
+		// Gathers the pixels of each row not skipped into one kernel call:
+		std::vector<int> &columns = mScratchColumns[worker];
+		GBuffer &scratch = mScratch[worker];
+		for (int row = t.y; row < t.y + t.height; row++) {
+			size_t begin = static_cast<size_t>(row) * mWidth;
+			columns.clear();
+			x.clear();
+			for (int column = t.x; column < t.x + t.width; column++) {
+				if (!mSkip[begin + column]) {
+					columns.push_back(column);
+					x.push_back(mColumnX[column]);
+				}
+			}
+			if (columns.empty()) {
+				continue;
+			}
+			y.assign(columns.size(), mRowY[row]);
+			scratch.resize(columns.size(), mGBuffer.channels);
+			mKernel(x.data(), y.data(), static_cast<int>(columns.size()), scratch.span());
+			for (size_t k = 0; k < columns.size(); k++) {
+				mGBuffer.copyPixel(begin + columns[k], scratch, k);
+			}
+		}
+	}
+
+	// Publishes the tile's pixels to snapshot():
+	mTileDone[tile].store(true, std::memory_order_release);
+	mTilesDone++;
+}
+
+int RenderJob::snapshot(GBuffer &gbuffer, int originX, int originY) const
+{
+	const int height = static_cast<int>(mGBuffer.size / mWidth);
+	int copied = 0;
+	for (size_t tile = 0; tile < mTiles.size(); tile++) {
+		if (!mTileDone[tile].load(std::memory_order_acquire)) {
+			continue;
+		}
+		const Tile &t = mTiles[tile];
+		for (int row = t.y; row < t.y + t.height; row++) {
+			size_t begin = static_cast<size_t>(row) * mWidth;
+			size_t stored = static_cast<size_t>((row + originY) % height) * mWidth;
+			for (int x = t.x; x < t.x + t.width; x++) {
+				if (mSkip.empty() || !mSkip[begin + x]) {
+					gbuffer.copyPixel(stored + (x + originX) % mWidth, mGBuffer, begin + x);
+				}
+			}
+		}
+		copied++;
+	}
+	return copied;
+}
+
+std::vector<RenderJob::Tile> RenderJob::tiles(int width, int height, bool centerOut)
+{
+	std::vector<Tile> tiles;
+	for (int y = 0; y < height; y += TILE_SIZE) {
+		for (int x = 0; x < width; x += TILE_SIZE) {
+			tiles.push_back({ x, y, std::min(TILE_SIZE, width - x), std::min(TILE_SIZE, height - y) });
+		}
+	}
+
+	if (centerOut) {
+		auto distance = [width, height](const Tile &t) {
+			long dx = 2L * t.x + t.width - width;
+			long dy = 2L * t.y + t.height - height;
+			return dx * dx + dy * dy;
+		};
+		std::stable_sort(tiles.begin(), tiles.end(), [&](const Tile &a, const Tile &b) {
+			return distance(a) < distance(b);
+		});
+	}
+	return tiles;
+}
+
+std::vector<RenderJob::Tile> RenderJob::tiles(int width, int height, bool centerOut, const std::vector<Tile> &regions)
+{
+	std::vector<Tile> covering;
+	for (const Tile &t : tiles(width, height, centerOut)) {
+		int left = t.x + t.width;
+		int top = t.y + t.height;
+		int right = t.x;
+		int bottom = t.y;
+		for (const Tile &r : regions) {
+			int x0 = std::max(t.x, r.x);
+			int y0 = std::max(t.y, r.y);
+			int x1 = std::min(t.x + t.width, r.x + r.width);
+			int y1 = std::min(t.y + t.height, r.y + r.height);
+			if (x0 < x1 && y0 < y1) {
+				left = std::min(left, x0);
+				top = std::min(top, y0);
+				right = std::max(right, x1);
+				bottom = std::max(bottom, y1);
+			}
+		}
+		if (left < right && top < bottom) {
+			covering.push_back({ left, top, right - left, bottom - top });
+		}
+	}
+	return covering;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "GBuffer.h"
+#include "ThreadPool.h"
+
+/**
+ * Tells a running render to stop, either on request or once a deadline has
+ * passed. Checked between tiles, so a render stops within one tile.
+ */
+class CancellationToken
+{
+
+private:
+
+	std::atomic<bool> mCancelled{ false };
+	std::chrono::steady_clock::time_point mDeadline = std::chrono::steady_clock::time_point::max();
+
+public:
+
+	inline void cancel() {
+		mCancelled = true;
+	}
+
+	inline void setDeadline(std::chrono::steady_clock::time_point deadline) {
+		mDeadline = deadline;
+	}
+
+	inline bool cancelRequested() const {
+		return mCancelled;
+	}
+
+	inline bool expired() const {
+		return mDeadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= mDeadline;
+	}
+
+	inline bool stopped() const {
+		return cancelRequested() || expired();
+	}
+
+};
+
+enum class RenderStatus {
+	COMPLETE,
+	CANCELLED,
+	// Stopped at the deadline:
+	EXPIRED
+};
+
+/**
+ * A frame rendered in the background, tile by tile, into its own G-buffer.
+ *
+ * The job owns a snapshot of the view it was started with, so the display
+ * can be changed while it runs. Finished tiles can be copied out at any
+ * time, which is how a cancelled or expired job still yields a partial
+ * frame. Destroying the job cancels it and waits for the running tiles.
+ */
+class RenderJob
+{
+
+public:
+
+	static const int TILE_SIZE = 16;
+
+	using Kernel = std::function<void(const double *x, const double *y, int count, const GBufferSpan &out)>;
+
+	struct Tile
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+
+private:
+
+	int mWidth;
+	Kernel mKernel;
+
+	// Plane coordinates of every pixel column and row:
+	std::vector<double> mColumnX;
+	std::vector<double> mRowY;
+
+	std::vector<Tile> mTiles;
+	std::unique_ptr<std::atomic<bool>[]> mTileDone;
+
+	// Pixels to leave out, row-major, none if empty:
+	std::vector<std::uint8_t> mSkip;
+	std::atomic<int> mTilesDone{ 0 };
+
+	GBuffer mGBuffer;
+	CancellationToken mToken;
+
+	// Per-worker scratch coordinates of a tile row, and its pixels if some are skipped:
+	std::vector<std::vector<double>> mScratchX;
+	std::vector<std::vector<double>> mScratchY;
+	std::vector<std::vector<int>> mScratchColumns;
+	std::vector<GBuffer> mScratch;
+
+	std::promise<RenderStatus> mPromise;
+	std::shared_future<RenderStatus> mStatus;
+	std::thread mThread;
+
+	void renderTile(int tile, int worker);
+
+public:
+
+	/**
+	 * Prepares a job for the given pixel-to-plane mapping. Tiles are
+	 * rendered in the order given by `tiles`. Pixels set in `skip`, if
+	 * given, are neither computed nor copied out by snapshot().
+	 */
+	RenderJob(int width, int height, unsigned channels, std::vector<double> columnX, std::vector<double> rowY,
+		Kernel kernel, std::vector<Tile> tiles, std::vector<std::uint8_t> skip = {});
+
+	~RenderJob();
+
+	RenderJob(const RenderJob &) = delete;
+
+	RenderJob &operator=(const RenderJob &) = delete;
+
+	/**
+	 * Starts rendering on the pool from a background thread. The tiles
+	 * share the workers with the other batches on the pool according to
+	 * `priority`.
+	 */
+	void start(ThreadPool &pool, std::chrono::steady_clock::time_point deadline,
+		ThreadPool::Priority priority = ThreadPool::Priority::VISIBLE);
+
+	inline void cancel() {
+		mToken.cancel();
+	}
+
+	inline const CancellationToken &token() const {
+		return mToken;
+	}
+
+	inline bool ready() const {
+		return mStatus.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	/**
+	 * Blocks until the job has completed or stopped.
+	 */
+	inline RenderStatus wait() const {
+		return mStatus.get();
+	}
+
+	inline const std::shared_future<RenderStatus> &status() const {
+		return mStatus;
+	}
+
+	inline int tileCount() const {
+		return static_cast<int>(mTiles.size());
+	}
+
+	inline int tilesDone() const {
+		return mTilesDone;
+	}
+
+	inline const std::vector<Tile> &tileList() const {
+		return mTiles;
+	}
+
+	inline bool tileDone(int tile) const {
+		return mTileDone[tile].load(std::memory_order_acquire);
+	}
+
+	/**
+	 * The job's own G-buffer. A tile may be read from it once tileDone()
+	 * has returned true for it.
+	 */
+	inline const GBuffer &gbuffer() const {
+		return mGBuffer;
+	}
+
+	/**
+	 * Copies the tiles finished so far into `gbuffer`, which must have the
+	 * same size and no channels the job lacks. Returns the number of tiles.
+	 * If `gbuffer` is a ring buffer, pixel (0, 0) is stored at
+	 * (originX, originY) and the pixels wrap around its edges.
+	 */
+	int snapshot(GBuffer &gbuffer, int originX = 0, int originY = 0) const;
+
+	/**
+	 * Splits a viewport into TILE_SIZE tiles, row by row or, if `centerOut`,
+	 * in order of distance to the center.
+	 */
+	static std::vector<Tile> tiles(int width, int height, bool centerOut);
+
+	/**
+	 * The tiles of the same grid which overlap any of `regions`, each cut
+	 * down to the bounding box of the overlap.
+	 */
+	static std::vector<Tile> tiles(int width, int height, bool centerOut, const std::vector<Tile> &regions);
+
+};
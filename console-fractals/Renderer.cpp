@@ -0,0 +1,89 @@
+#include "Renderer.h"
+#include <algorithm>
+#include "DiskCache.h"
+
+const double RenderRequest::LOGIC_VIEWPORT_SIZE_MUL = 2;
+
+Renderer::Renderer(ThreadPool &pool, DiskCache *cache)
+	: mPool(pool),
+	mCache(cache)
+{
+}
+
+RenderJob::Kernel Renderer::kernel(const RenderRequest &request)
+{
+	EscapeParams params = request.params;
+
+	if (request.program) {
+		std::shared_ptr<const FormulaProgram> program = request.program;
+		return [params, program](const double *x, const double *y, int count, const GBufferSpan &out) {
+			program->escape(params, x, y, count, out);
+		};
+	}
+
+	const KernelTable &table = request.kernels ? *request.kernels : kernels::best();
+	Precision precision = request.precision;
+	Formula formula = request.formula;
+	return [params, &table, precision, formula](const double *x, const double *y, int count, const GBufferSpan &out) {
+		table.escape(precision, formula, out.channels())(params, x, y, count, out);
+	};
+}
+
+void Renderer::render(const RenderRequest &request, GBuffer &out)
+{
+	render(request, out, [](int) {});
+}
+
+void Renderer::render(const RenderRequest &request, GBuffer &out, const std::function<void(int tile)> &onTile)
+{
+	const int width = request.width;
+	std::vector<RenderJob::Tile> tiles = RenderJob::tiles(width, request.height, false);
+	if (mCache && mCache->load(request, out)) {
+		for (size_t tile = 0; tile < tiles.size(); tile++) {
+			onTile(static_cast<int>(tile));
+		}
+		return;
+	}
+	out.resize(static_cast<size_t>(width) * request.height, request.channels);
+
+	std::vector<double> columnX(width);
+	for (int x = 0; x < width; x++) {
+		columnX[x] = request.planeX(x);
+	}
+	RenderJob::Kernel escape = kernel(request);
+
+	// Scratch rows of this call only, other renders may be using the same workers:
+	std::vector<std::vector<double>> scratchY(mPool.size());
+
+	mPool.run(static_cast<int>(tiles.size()), [&](int tile, int worker) {
+		const RenderJob::Tile &t = tiles[tile];
+		std::vector<double> &y = scratchY[worker];
+		y.resize(t.width);
+		for (int row = t.y; row < t.y + t.height; row++) {
+			std::fill(y.begin(), y.end(), request.planeY(row));
+			escape(&columnX[t.x], y.data(), t.width, out.span(static_cast<size_t>(row) * width + t.x));
+		}
+		onTile(tile);
+	}, request.priority);
+
+	if (mCache) {
+		mCache->store(request, out);
+	}
+}
+
+std::unique_ptr<RenderJob> Renderer::renderAsync(const RenderRequest &request, std::chrono::steady_clock::time_point deadline)
+{
+	std::vector<double> columnX(request.width);
+	std::vector<double> rowY(request.height);
+	for (int x = 0; x < request.width; x++) {
+		columnX[x] = request.planeX(x);
+	}
+	for (int y = 0; y < request.height; y++) {
+		rowY[y] = request.planeY(y);
+	}
+
+	std::unique_ptr<RenderJob> job(new RenderJob(request.width, request.height, request.channels,
+		std::move(columnX), std::move(rowY), kernel(request), RenderJob::tiles(request.width, request.height, false)));
+	job->start(mPool, deadline, request.priority);
+	return job;
+}
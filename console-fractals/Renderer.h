@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include "glm/glm.hpp"
+#include "FormulaVM.h"
+#include "GBuffer.h"
+#include "Kernels.h"
+#include "RenderJob.h"
+#include "ThreadPool.h"
+
+class DiskCache;
+
+/**
+ * Everything a render depends on. Requests are plain values, so any number
+ * of them can be rendered at once without sharing state.
+ */
+struct RenderRequest
+{
+	// Half the width of the plane shown at zoom 1, as in the Vulkan viewer:
+	static const double LOGIC_VIEWPORT_SIZE_MUL;
+
+	Formula formula = Formula::MANDELBROT;
+
+	// Interpreted instead of `formula` if set:
+	std::shared_ptr<const FormulaProgram> program;
+
+	// Iteration cap, Julia constant and orbit trap:
+	EscapeParams params;
+
+	Precision precision = Precision::DOUBLE;
+
+	// Kernel variant to use, the best supported one if null:
+	const KernelTable *kernels = nullptr;
+
+	// Viewport size in pixels, and the point of the plane at its center:
+	int width = 0;
+	int height = 0;
+	glm::dvec2 center{ 0, 0 };
+	double zoom = 1;
+
+	unsigned channels = CHANNELS_BASIC;
+
+	// Class of the render's tiles on the shared pool:
+	ThreadPool::Priority priority = ThreadPool::Priority::VISIBLE;
+
+	/**
+	 * Maps a (possibly fractional) pixel column to the plane.
+	 */
+	inline double planeX(double x) const {
+		return (x - width / 2) / width * 2 * LOGIC_VIEWPORT_SIZE_MUL / zoom + center.x;
+	}
+
+	/**
+	 * Maps a (possibly fractional) pixel row to the plane. Rows grow downwards.
+	 */
+	inline double planeY(double y) const {
+		return ((height - y) - height / 2) / height * 2 * LOGIC_VIEWPORT_SIZE_MUL / zoom + center.y;
+	}
+};
+
+/**
+ * Renders requests on a shared thread pool. Reentrant: any number of
+ * threads may render through the same Renderer at once. The pool schedules
+ * the tiles of concurrent renders by the priority of their requests, so an
+ * interactive preview overtakes a batch render after at most one tile per
+ * worker.
+ */
+class Renderer
+{
+
+private:
+
+	ThreadPool &mPool;
+	DiskCache *mCache;
+
+public:
+
+	/**
+	 * Renders on `pool`, reading and storing complete renders in `cache`
+	 * if given.
+	 */
+	explicit Renderer(ThreadPool &pool, DiskCache *cache = nullptr);
+
+	/**
+	 * The escape function of a request, for points of the plane. It owns a
+	 * copy of everything it reads, so it stays valid after the request.
+	 */
+	static RenderJob::Kernel kernel(const RenderRequest &request);
+
+	/**
+	 * Renders the request into `out`, which is resized to fit it, and
+	 * returns once all tiles are done.
+	 */
+	void render(const RenderRequest &request, GBuffer &out);
+
+	/**
+	 * Same, calling `onTile` from the worker as soon as each tile of
+	 * RenderJob::tiles(width, height, false) is done, or for every tile
+	 * from the calling thread if the disk cache has the render.
+	 */
+	void render(const RenderRequest &request, GBuffer &out, const std::function<void(int tile)> &onTile);
+
+	/**
+	 * Starts rendering the request in the background, see RenderJob. The
+	 * disk cache is not used, as the job's tiles are read while it runs.
+	 */
+	std::unique_ptr<RenderJob> renderAsync(const RenderRequest &request,
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+};
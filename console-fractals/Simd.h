@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Minimal portable vector types for the escape kernels.
+ *
+ * On GCC and Clang a Pack is a native vector of the target's register width,
+ * so one kernel source compiles to SSE, AVX or AVX-512 code depending on the
+ * flags of the translation unit including it. Other compilers fall back to
+ * single-lane packs, which still profit from interleaving independent chains.
+ */
+
+// Width of one SIMD register of the compilation target, in bytes:
+#if defined(__AVX512F__)
+#define SIMD_VECTOR_BYTES 64
+#elif defined(__AVX__)
+#define SIMD_VECTOR_BYTES 32
+#elif defined(__SSE2__) || defined(__ARM_NEON)
+#define SIMD_VECTOR_BYTES 16
+#else
+#define SIMD_VECTOR_BYTES 0
+#endif
+
+#if defined(__GNUC__) && SIMD_VECTOR_BYTES > 0
+#define SIMD_NATIVE_VECTORS 1
+#else
+#define SIMD_NATIVE_VECTORS 0
+#endif
+
+// Each translation unit gets its own copy, so the same template compiled
+// with different target flags never collides at link time.
+namespace simd {
+namespace {
+
+template<class Real>
+struct MaskElement;
+
+template<>
+struct MaskElement<float>
+{
+	using Type = std::int32_t;
+};
+
+template<>
+struct MaskElement<double>
+{
+	using Type = std::int64_t;
+};
+
+#if SIMD_NATIVE_VECTORS
+
+template<class Real>
+struct Pack
+{
+	static constexpr int LANES = SIMD_VECTOR_BYTES / sizeof(Real);
+	typedef Real Vec __attribute__((vector_size(SIMD_VECTOR_BYTES)));
+	typedef typename MaskElement<Real>::Type Mask __attribute__((vector_size(SIMD_VECTOR_BYTES)));
+};
+
+template<class Vec, class Real>
+inline Vec splat(Real value)
+{
+	return Vec{} + value;
+}
+
+template<class Vec, class Mask>
+inline Vec select(Mask mask, Vec a, Vec b)
+{
+	return reinterpret_cast<Vec>((reinterpret_cast<Mask>(a) & mask) | (reinterpret_cast<Mask>(b) & ~mask));
+}
+
+template<class Vec>
+inline Vec abs(Vec v)
+{
+	return select(v < Vec{}, -v, v);
+}
+
+template<class Mask>
+inline bool any(Mask mask)
+{
+	constexpr int LANES = sizeof(Mask) / sizeof(mask[0]);
+	for (int l = 1; l < LANES; l++) {
+		mask[0] |= mask[l];
+	}
+	return mask[0] != 0;
+}
+
+template<class Vec>
+inline auto lane(const Vec &v, int l)
+{
+	return v[l];
+}
+
+template<class Vec, class Real>
+inline void setLane(Vec &v, int l, Real value)
+{
+	v[l] = value;
+}
+
+#else
+
+template<class Real>
+struct Pack
+{
+	static constexpr int LANES = 1;
+	using Vec = Real;
+	using Mask = bool;
+};
+
+template<class Vec, class Real>
+inline Vec splat(Real value)
+{
+	return value;
+}
+
+template<class Vec>
+inline Vec select(bool mask, Vec a, Vec b)
+{
+	return mask ? a : b;
+}
+
+template<class Vec>
+inline Vec abs(Vec v)
+{
+	return v < 0 ? -v : v;
+}
+
+inline bool any(bool mask)
+{
+	return mask;
+}
+
+template<class Vec>
+inline Vec lane(const Vec &v, int)
+{
+	return v;
+}
+
+template<class Vec, class Real>
+inline void setLane(Vec &v, int, Real value)
+{
+	v = value;
+}
+
+#endif
+
+}
+}
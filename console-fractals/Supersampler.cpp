@@ -0,0 +1,153 @@
+#include "Supersampler.h"
+#include <algorithm>
+#include <cmath>
+
+// Samples added per round once the minimum is reached:
+static const int ROUND_SAMPLES = 4;
+
+void Supersampler::jitter(int k, double &dx, double &dy)
+{
+	// R2 sequence, generated by the plastic number g: x^3 = x + 1
+	const double g = 1.32471795724474602596;
+	const double a1 = 1 / g;
+	const double a2 = 1 / (g * g);
+	double u = 0.5 + a1 * k;
+	double v = 0.5 + a2 * k;
+	dx = u - std::floor(u) - 0.5;
+	dy = v - std::floor(v) - 0.5;
+}
+
+void Supersampler::detectEdges(const GBuffer &gbuffer, int width, int height, int maxIterations)
+{
+	const int *iterations = gbuffer.iterations.data();
+	const float *smooth = gbuffer.smooth.data();
+
+	auto differs = [&](size_t a, size_t b) {
+		bool insideA = iterations[a] >= maxIterations;
+		bool insideB = iterations[b] >= maxIterations;
+		if (insideA != insideB) {
+			return true;
+		}
+		return !insideA && std::abs(smooth[a] - smooth[b]) > mThreshold;
+	};
+
+	mPixels.clear();
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			size_t i = static_cast<size_t>(y) * width + x;
+			if ((x > 0 && differs(i, i - 1)) || (x + 1 < width && differs(i, i + 1))
+				|| (y > 0 && differs(i, i - width)) || (y + 1 < height && differs(i, i + width))) {
+				mPixels.push_back(i);
+			}
+		}
+	}
+}
+
+bool Supersampler::converged(size_t pixel) const
+{
+	double n = mSampleCount[pixel];
+	double escaped = mEscaped[pixel];
+	double p = escaped / n;
+	if (std::sqrt(p * (1 - p) / n) >= mTolerance) {
+		return false;
+	}
+	if (escaped < 2) {
+		return true;
+	}
+	double mean = mSum[pixel] / escaped;
+	double variance = std::max(0.0, mSquares[pixel] / escaped - mean * mean);
+	return std::sqrt(variance / escaped) < mTolerance;
+}
+
+void Supersampler::refine(GBuffer &gbuffer, int width, int height, int maxIterations, const Sampler &sampler)
+{
+	mStats = Stats();
+	mCoverage.resize(gbuffer.size);
+	for (size_t i = 0; i < gbuffer.size; i++) {
+		mCoverage[i] = gbuffer.iterations[i] < maxIterations ? 1.0f : 0.0f;
+	}
+	if (gbuffer.smooth.empty()) {
+		return;
+	}
+
+	detectEdges(gbuffer, width, height, maxIterations);
+	mStats.edgePixels = mPixels.size();
+
+	// The render already took sample 0, the pixel center:
+	size_t edges = mPixels.size();
+	mEscaped.resize(edges);
+	mSampleCount.assign(edges, 1);
+	mSum.resize(edges);
+	mSquares.resize(edges);
+	for (size_t e = 0; e < edges; e++) {
+		size_t i = mPixels[e];
+		bool escaped = gbuffer.iterations[i] < maxIterations;
+		double s = gbuffer.smooth[i];
+		mEscaped[e] = escaped ? 1 : 0;
+		mSum[e] = escaped ? s : 0;
+		mSquares[e] = escaped ? s * s : 0;
+	}
+
+	std::vector<size_t> active(edges);
+	for (size_t e = 0; e < edges; e++) {
+		active[e] = e;
+	}
+
+	int target = mMinSamples;
+	while (!active.empty()) {
+		// Gather the next samples of every unconverged pixel into one kernel call:
+		mX.clear();
+		mY.clear();
+		mOwner.clear();
+		for (size_t e : active) {
+			size_t i = mPixels[e];
+			double cx = static_cast<double>(i % width);
+			double cy = static_cast<double>(i / width);
+			for (int k = mSampleCount[e]; k < target; k++) {
+				double dx, dy;
+				jitter(k, dx, dy);
+				mX.push_back(cx + dx);
+				mY.push_back(cy + dy);
+				mOwner.push_back(e);
+			}
+		}
+
+		size_t count = mX.size();
+		mIterations.resize(count);
+		mSmooth.resize(count);
+		GBufferSpan span;
+		span.iterations = mIterations.data();
+		span.smooth = mSmooth.data();
+		sampler(mX.data(), mY.data(), static_cast<int>(count), span);
+		mStats.samples += count;
+
+		for (size_t s = 0; s < count; s++) {
+			size_t e = mOwner[s];
+			mSampleCount[e]++;
+			if (mIterations[s] < maxIterations) {
+				mEscaped[e]++;
+				mSum[e] += mSmooth[s];
+				mSquares[e] += static_cast<double>(mSmooth[s]) * mSmooth[s];
+			}
+		}
+
+		active.erase(std::remove_if(active.begin(), active.end(), [&](size_t e) {
+			return mSampleCount[e] >= mMaxSamples || converged(e);
+		}), active.end());
+		target = std::min(mMaxSamples, target + ROUND_SAMPLES);
+	}
+
+	for (size_t e = 0; e < edges; e++) {
+		size_t i = mPixels[e];
+		mCoverage[i] = static_cast<float>(mEscaped[e]) / mSampleCount[e];
+		if (mEscaped[e] * 2 < mSampleCount[e]) {
+			gbuffer.iterations[i] = maxIterations;
+			gbuffer.smooth[i] = static_cast<float>(maxIterations);
+		}
+		else {
+			double mean = mSum[e] / mEscaped[e];
+			gbuffer.smooth[i] = static_cast<float>(mean);
+			gbuffer.iterations[i] = std::max(0, std::min(maxIterations - 1, static_cast<int>(mean)));
+		}
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "GBuffer.h"
+
+/**
+ * Adaptive anti-aliasing of a rendered G-buffer.
+ *
+ * Only pixels whose neighbours fall in the other iteration class (inside or
+ * escaped) or differ in smooth count by more than a threshold are refined.
+ * Their samples follow the R2 low-discrepancy sequence, whose first point is
+ * the pixel center the render already computed, and stop as soon as the
+ * estimate has converged. Flat regions cost nothing beyond the render.
+ */
+class Supersampler
+{
+
+public:
+
+	/**
+	 * Computes `count` samples at pixel coordinates (px, py), with pixel
+	 * centers at integers. Fills the iteration and smooth channels of `out`.
+	 */
+	using Sampler = std::function<void(const double *px, const double *py, int count, const GBufferSpan &out)>;
+
+	struct Stats
+	{
+		// Pixels flagged as edges, and samples taken beyond the render:
+		size_t edgePixels = 0;
+		size_t samples = 0;
+	};
+
+private:
+
+	double mThreshold = 1;
+	int mMinSamples = 4;
+	int mMaxSamples = 16;
+	double mTolerance = 0.1;
+
+	// Per flagged pixel: index, escaped samples, sum and squared sum of their smooth counts:
+	std::vector<size_t> mPixels;
+	std::vector<int> mEscaped;
+	std::vector<int> mSampleCount;
+	std::vector<double> mSum;
+	std::vector<double> mSquares;
+
+	// Scratch of one sampling round:
+	std::vector<double> mX;
+	std::vector<double> mY;
+	std::vector<int> mIterations;
+	std::vector<float> mSmooth;
+	std::vector<size_t> mOwner;
+
+	// Fraction of the samples of each pixel which escaped:
+	std::vector<float> mCoverage;
+
+	Stats mStats;
+
+	void detectEdges(const GBuffer &gbuffer, int width, int height, int maxIterations);
+
+	bool converged(size_t pixel) const;
+
+public:
+
+	/**
+	 * Neighbours whose smooth counts differ by more than this are an edge.
+	 */
+	inline void setThreshold(double threshold) {
+		mThreshold = threshold;
+	}
+
+	/**
+	 * Samples per edge pixel, including the center. Sampling stops between
+	 * the two once the standard errors drop below `tolerance`, both of the
+	 * smooth count and of the escaped fraction.
+	 */
+	inline void setSamples(int minSamples, int maxSamples, double tolerance) {
+		mMinSamples = minSamples > 1 ? minSamples : 1;
+		mMaxSamples = maxSamples > mMinSamples ? maxSamples : mMinSamples;
+		mTolerance = tolerance;
+	}
+
+	/**
+	 * Refines the edge pixels of a G-buffer which has the smooth channel.
+	 * An edge pixel gets the class of most of its samples, and the mean
+	 * smooth count of the escaped ones. Other channels keep the values of
+	 * the pixel center.
+	 */
+	void refine(GBuffer &gbuffer, int width, int height, int maxIterations, const Sampler &sampler);
+
+	/**
+	 * Escaped fraction of the samples of each pixel of the last refine().
+	 */
+	inline const std::vector<float> &coverage() const {
+		return mCoverage;
+	}
+
+	inline const Stats &stats() const {
+		return mStats;
+	}
+
+	/**
+	 * Offset of the k-th sample from the pixel center, in [-0.5, 0.5)^2.
+	 * Sample 0 is the center itself.
+	 */
+	static void jitter(int k, double &dx, double &dy);
+
+};
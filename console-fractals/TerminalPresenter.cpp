@@ -0,0 +1,151 @@
+#include "TerminalPresenter.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Unchanged characters cheaper to resend than to jump over with CSI row;column H:
+static const int JUMP_COST = 8;
+
+// Repetitions worth a REP sequence, which costs at least four bytes:
+static const int REPEAT_MIN = 6;
+
+void appendNumber(std::vector<char> &out, int value)
+{
+	char digits[16];
+	int length = 0;
+	do {
+		digits[length++] = static_cast<char>('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+	while (length > 0) {
+		out.push_back(digits[--length]);
+	}
+}
+
+TerminalPresenter::TerminalPresenter(int fd)
+	: mFd(fd)
+{
+}
+
+void TerminalPresenter::append(const char *data, size_t size)
+{
+	mOut.insert(mOut.end(), data, data + size);
+}
+
+void TerminalPresenter::moveTo(int row, int column)
+{
+	if (row == mCursorRow && column == mCursorColumn) {
+		return;
+	}
+	append("\x1b[", 2);
+	appendNumber(mOut, row + 1);
+	mOut.push_back(';');
+	appendNumber(mOut, column + 1);
+	mOut.push_back('H');
+	mCursorRow = row;
+	mCursorColumn = column;
+}
+
+void TerminalPresenter::appendRun(const char *row, int begin, int end)
+{
+	for (int i = begin; i < end;) {
+		char c = row[i];
+		int n = 1;
+		while (i + n < end && row[i + n] == c) {
+			n++;
+		}
+
+		if (mRepeat && n >= REPEAT_MIN) {
+			mOut.push_back(c);
+			append("\x1b[", 2);
+			appendNumber(mOut, n - 1);
+			mOut.push_back('b');
+		}
+		else {
+			mOut.insert(mOut.end(), n, c);
+		}
+		i += n;
+	}
+
+	mCursorColumn += end - begin;
+	if (mCursorColumn >= mWidth) {
+		// The terminal may be waiting to wrap, so the position is uncertain:
+		mCursorRow = -1;
+		mCursorColumn = -1;
+	}
+}
+
+void TerminalPresenter::flush()
+{
+	write(mFd, mOut.data(), mOut.size());
+}
+
+void TerminalPresenter::write(int fd, const char *data, size_t size)
+{
+	size_t remaining = size;
+	while (remaining > 0) {
+#ifdef _WIN32
+		int written = _write(fd, data, static_cast<unsigned>(remaining));
+#else
+		ssize_t written = ::write(fd, data, remaining);
+#endif
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		data += written;
+		remaining -= static_cast<size_t>(written);
+	}
+}
+
+void TerminalPresenter::present(const std::vector<std::string> &rows)
+{
+	const int height = static_cast<int>(rows.size());
+	const int width = height > 0 ? static_cast<int>(rows[0].size()) : 0;
+
+	mOut.clear();
+	if (!mValid || width != mWidth || height != mHeight) {
+		// A cleared screen is all spaces, so blank runs need not be sent:
+		append("\x1b[H\x1b[2J", 7);
+		mCursorRow = 0;
+		mCursorColumn = 0;
+		mWidth = width;
+		mHeight = height;
+		mPrevious.assign(static_cast<size_t>(width) * height, ' ');
+		mValid = true;
+	}
+
+	for (int y = 0; y < height; y++) {
+		const char *current = rows[y].data();
+		char *previous = &mPrevious[static_cast<size_t>(y) * width];
+
+		for (int x = 0; x < width;) {
+			if (current[x] == previous[x]) {
+				x++;
+				continue;
+			}
+			// Extend the run over short unchanged gaps:
+			int last = x;
+			for (int i = x + 1; i < width && i - last <= JUMP_COST; i++) {
+				if (current[i] != previous[i]) {
+					last = i;
+				}
+			}
+			moveTo(y, x);
+			appendRun(current, x, last + 1);
+			x = last + 1;
+		}
+		std::memcpy(previous, current, width);
+	}
+
+	moveTo(height, 0);
+	mLastFrameBytes = mOut.size();
+	flush();
+}
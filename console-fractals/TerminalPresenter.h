@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Appends the decimal digits of `value`, which must not be negative.
+ */
+void appendNumber(std::vector<char> &out, int value);
+
+/**
+ * Presents frames of characters on an ANSI terminal, sending only what
+ * changed since the previous frame.
+ *
+ * Changed runs of a row are reached with cursor positioning, unchanged
+ * gaps too short to be worth a jump are resent, and runs of one character
+ * are compressed with the REP sequence (CSI n b). The whole frame is built
+ * in one reused buffer and written with a single write(), so a frame never
+ * tears and costs one system call.
+ *
+ * The frame is drawn from the top left corner of the screen, and the
+ * cursor is left on the line below it.
+ */
+class TerminalPresenter
+{
+
+private:
+
+	int mFd;
+	bool mRepeat = true;
+
+	// The frame on screen, row-major, and its size:
+	std::vector<char> mPrevious;
+	int mWidth = 0;
+	int mHeight = 0;
+	bool mValid = false;
+
+	std::vector<char> mOut;
+	size_t mLastFrameBytes = 0;
+
+	// Cursor position after the output so far, -1 if unknown:
+	int mCursorRow = -1;
+	int mCursorColumn = -1;
+
+	void append(const char *data, size_t size);
+
+	void moveTo(int row, int column);
+
+	/**
+	 * Appends a row's characters [begin, end), compressing repetitions.
+	 */
+	void appendRun(const char *row, int begin, int end);
+
+	void flush();
+
+public:
+
+	/**
+	 * Writes all of `data` to `fd`, retrying after interruptions.
+	 */
+	static void write(int fd, const char *data, size_t size);
+
+	/**
+	 * Writes to the given file descriptor, stdout by default.
+	 */
+	explicit TerminalPresenter(int fd = 1);
+
+	/**
+	 * Whether to compress repeated characters with REP, which a few
+	 * terminals lack.
+	 */
+	inline void setRepeat(bool repeat) {
+		mRepeat = repeat;
+		mValid = false;
+	}
+
+	/**
+	 * Redraws the whole frame next time, e.g. after other output.
+	 */
+	inline void invalidate() {
+		mValid = false;
+	}
+
+	void present(const std::vector<std::string> &rows);
+
+	/**
+	 * Bytes written for the last frame.
+	 */
+	inline size_t lastFrameBytes() const {
+		return mLastFrameBytes;
+	}
+
+};
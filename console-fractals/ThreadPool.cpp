@@ -0,0 +1,95 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int workers)
+{
+	for (int p = 0; p < PRIORITY_COUNT; p++) {
+		mCursors[p] = mBatches[p].end();
+	}
+
+	if (workers <= 0) {
+		workers = static_cast<int>(std::thread::hardware_concurrency());
+	}
+	if (workers <= 0) {
+		workers = 1;
+	}
+
+	for (int i = 0; i < workers; i++) {
+		mWorkers.emplace_back(&ThreadPool::work, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock{ mMutex };
+		mStopping = true;
+	}
+	mWake.notify_all();
+	for (auto &worker : mWorkers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::run(int count, const std::function<void(int task, int worker)> &task, Priority priority)
+{
+	if (count <= 0) {
+		return;
+	}
+
+	Batch batch{ &task, count, 0, 0 };
+	std::unique_lock<std::mutex> lock{ mMutex };
+	mBatches[static_cast<int>(priority)].push_back(&batch);
+	mWake.notify_all();
+
+	mDone.wait(lock, [&batch] { return batch.finished == batch.count; });
+}
+
+bool ThreadPool::idle() const
+{
+	for (const auto &batches : mBatches) {
+		if (!batches.empty()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void ThreadPool::work(int worker)
+{
+	std::unique_lock<std::mutex> lock{ mMutex };
+
+	while (true) {
+		mWake.wait(lock, [this] { return mStopping || !idle(); });
+		if (mStopping) {
+			return;
+		}
+
+		// The most urgent class first, round robin over its batches:
+		int p = 0;
+		while (mBatches[p].empty()) {
+			p++;
+		}
+		std::list<Batch *> &batches = mBatches[p];
+		std::list<Batch *>::iterator &cursor = mCursors[p];
+		if (cursor == batches.end()) {
+			cursor = batches.begin();
+		}
+		Batch *batch = *cursor;
+		int i = batch->next++;
+		if (batch->next == batch->count) {
+			// Fully claimed, the caller waits for the tasks still running:
+			cursor = batches.erase(cursor);
+		}
+		else {
+			++cursor;
+		}
+
+		lock.unlock();
+		(*batch->task)(i, worker);
+		lock.lock();
+
+		if (++batch->finished == batch->count) {
+			mDone.notify_all();
+		}
+	}
+}
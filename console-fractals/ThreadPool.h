@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads running batches of indexed tasks.
+ *
+ * Any number of threads may run batches at the same time. A free worker
+ * takes the next task of the most urgent priority class with work left,
+ * taking from the batches of that class in turn. So an urgent batch takes
+ * over the workers as soon as their current tasks finish, and batches of
+ * the same class share the pool evenly. Less urgent classes wait until the
+ * more urgent ones are fully claimed.
+ */
+class ThreadPool
+{
+
+public:
+
+	enum class Priority {
+		// Previews the user is waiting for:
+		INTERACTIVE,
+		// Parts of the visible frame:
+		VISIBLE,
+		// Work likely to be needed soon, such as neighbouring tiles:
+		PREFETCH,
+		BATCH
+	};
+
+	static const int PRIORITY_COUNT = 4;
+
+private:
+
+	struct Batch
+	{
+		const std::function<void(int task, int worker)> *task;
+		int count;
+		int next;
+		int finished;
+	};
+
+	std::vector<std::thread> mWorkers;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+
+	// Running batches with unclaimed tasks per priority, and the one to take from next:
+	std::list<Batch *> mBatches[PRIORITY_COUNT];
+	std::list<Batch *>::iterator mCursors[PRIORITY_COUNT];
+	bool mStopping = false;
+
+	bool idle() const;
+
+	void work(int worker);
+
+public:
+
+	/**
+	 * Starts the given number of workers, or one per hardware thread if 0.
+	 */
+	explicit ThreadPool(int workers = 0);
+
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	inline int size() const {
+		return static_cast<int>(mWorkers.size());
+	}
+
+	/**
+	 * Runs task(0) ... task(count - 1) on the workers and blocks until all
+	 * have finished. The worker index passed along is below size(), so it
+	 * can select per-thread scratch data of this batch.
+	 */
+	void run(int count, const std::function<void(int task, int worker)> &task, Priority priority = Priority::VISIBLE);
+
+};
@@ -0,0 +1,140 @@
+#include "TileCache.h"
+#include "Hash.h"
+
+bool TileCache::Key::operator==(const Key &other) const
+{
+	return request == other.request && maxIterations == other.maxIterations && channels == other.channels
+		&& pitchX == other.pitchX && pitchY == other.pitchY && tileX == other.tileX && tileY == other.tileY;
+}
+
+size_t TileCache::KeyHash::operator()(const Key &key) const
+{
+	std::uint64_t hash = FNV_OFFSET;
+	mix(hash, key.request);
+	mix(hash, key.maxIterations);
+	mix(hash, key.channels);
+	mix(hash, key.pitchX);
+	mix(hash, key.pitchY);
+	mix(hash, key.tileX);
+	mix(hash, key.tileY);
+	return static_cast<size_t>(hash);
+}
+
+TileCache::TileCache(size_t budget)
+	: mBudget(budget)
+{
+}
+
+std::uint64_t TileCache::fingerprint(const RenderRequest &request)
+{
+	std::uint64_t hash = FNV_OFFSET;
+	if (request.program) {
+		for (char c : request.program->source()) {
+			mix(hash, c);
+		}
+	}
+	else {
+		mix(hash, static_cast<int>(request.formula));
+	}
+	mix(hash, request.params.julia);
+	mix(hash, request.params.juliaX);
+	mix(hash, request.params.juliaY);
+	mix(hash, request.params.trapX);
+	mix(hash, request.params.trapY);
+	mix(hash, static_cast<int>(request.precision));
+	mix(hash, static_cast<int>(request.kernels ? request.kernels->isa : kernels::best().isa));
+	return hash;
+}
+
+size_t TileCache::bytes(const Tile &tile)
+{
+	const GBuffer &s = tile.samples;
+	return sizeof(Slot) + s.iterations.size() * sizeof(int)
+		+ (s.smooth.size() + s.magnitude.size() + s.distance.size() + s.trap.size()) * sizeof(float);
+}
+
+const TileCache::Tile *TileCache::find(const Key &key)
+{
+	auto found = mIndex.find(key);
+	if (found == mIndex.end()) {
+		mStats.misses++;
+		return nullptr;
+	}
+	mStats.hits++;
+	Slot &slot = mSlots[found->second];
+	slot.referenced = true;
+	return &slot.tile;
+}
+
+void TileCache::makeRoom(size_t bytes)
+{
+	// Two rounds of the hand clear every reference bit, so this ends:
+	while (mStats.bytes + bytes > mBudget && mStats.tiles > 0) {
+		mHand = (mHand + 1) % mSlots.size();
+		Slot &slot = mSlots[mHand];
+		if (!slot.used) {
+			continue;
+		}
+		if (slot.referenced) {
+			slot.referenced = false;
+			continue;
+		}
+		mStats.bytes -= this->bytes(slot.tile);
+		mStats.tiles--;
+		mStats.evictions++;
+		mIndex.erase(slot.key);
+		slot.used = false;
+		slot.tile = Tile();
+		mFree.push_back(mHand);
+	}
+}
+
+void TileCache::insert(const Key &key, const Tile &tile)
+{
+	auto found = mIndex.find(key);
+	if (found != mIndex.end()) {
+		Tile &stored = mSlots[found->second].tile;
+		for (size_t p = 0; p < TILE_PIXELS; p++) {
+			if (tile.valid[p] && !stored.valid[p]) {
+				stored.samples.copyPixel(p, tile.samples, p);
+			}
+		}
+		stored.valid |= tile.valid;
+		return;
+	}
+
+	const size_t size = bytes(tile);
+	if (size > mBudget) {
+		return;
+	}
+	makeRoom(size);
+
+	size_t index;
+	if (!mFree.empty()) {
+		index = mFree.back();
+		mFree.pop_back();
+	}
+	else {
+		index = mSlots.size();
+		mSlots.emplace_back();
+	}
+	Slot &slot = mSlots[index];
+	slot.key = key;
+	slot.tile = tile;
+	slot.used = true;
+	// New tiles wait a round for their first hit:
+	slot.referenced = false;
+	mIndex[key] = index;
+	mStats.bytes += size;
+	mStats.tiles++;
+}
+
+void TileCache::clear()
+{
+	mSlots.clear();
+	mFree.clear();
+	mIndex.clear();
+	mHand = 0;
+	mStats.bytes = 0;
+	mStats.tiles = 0;
+}
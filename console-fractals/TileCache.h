@@ -0,0 +1,123 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "GBuffer.h"
+#include "Renderer.h"
+
+/**
+ * Keeps rendered tiles in memory, addressed by their place in the plane
+ * rather than on screen, so a view can take over whatever an earlier view
+ * of the same samples computed: a pan back to an area seen before, a zoom
+ * back out, or a parameter toggled back and forth.
+ *
+ * Tiles lie on the lattice of points (i, j) * pitch. Tile (x, y) holds the
+ * TILE_SIZE x TILE_SIZE points from (x, y) * TILE_SIZE on, with i growing
+ * to the right and j upwards. A tile may hold only some of its points,
+ * e.g. at the edge of a view, and points stored later are merged into it.
+ *
+ * The cache holds tiles up to a budget in bytes and evicts with the CLOCK
+ * algorithm: a tile found since the hand last passed it gets another round,
+ * so recently used tiles stay, at the cost of a bit per tile rather than a
+ * list reordered on every hit. Not thread-safe, like the display using it.
+ */
+class TileCache
+{
+
+public:
+
+	static const int TILE_SIZE = RenderJob::TILE_SIZE;
+	static const int TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+
+	struct Key
+	{
+		// Everything else the samples depend on, see fingerprint():
+		std::uint64_t request;
+		int maxIterations;
+		unsigned channels;
+		// Distance between lattice points, the zoom level:
+		double pitchX;
+		double pitchY;
+		std::int64_t tileX;
+		std::int64_t tileY;
+
+		bool operator==(const Key &other) const;
+	};
+
+	struct Tile
+	{
+		// Row-major from the top left point, (x, y) * TILE_SIZE + (0, TILE_SIZE - 1):
+		GBuffer samples;
+		std::bitset<TILE_PIXELS> valid;
+	};
+
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t evictions = 0;
+		size_t bytes = 0;
+		size_t tiles = 0;
+	};
+
+private:
+
+	struct KeyHash
+	{
+		size_t operator()(const Key &key) const;
+	};
+
+	struct Slot
+	{
+		Key key;
+		Tile tile;
+		bool used = false;
+		bool referenced = false;
+	};
+
+	size_t mBudget;
+	std::vector<Slot> mSlots;
+	std::vector<size_t> mFree;
+	std::unordered_map<Key, size_t, KeyHash> mIndex;
+	size_t mHand = 0;
+	Stats mStats;
+
+	static size_t bytes(const Tile &tile);
+
+	/**
+	 * Evicts tiles until `bytes` more fit into the budget.
+	 */
+	void makeRoom(size_t bytes);
+
+public:
+
+	explicit TileCache(size_t budget);
+
+	/**
+	 * Hash of everything in `request` the samples depend on besides the
+	 * iteration cap and the sample points: the formula, the parameters, the
+	 * precision and the kernel variant.
+	 */
+	static std::uint64_t fingerprint(const RenderRequest &request);
+
+	/**
+	 * The tile of `key`, or null. Valid until the next insert().
+	 */
+	const Tile *find(const Key &key);
+
+	/**
+	 * Stores the valid points of `tile` under `key`, filling in the points
+	 * not stored yet; points stored before are kept.
+	 */
+	void insert(const Key &key, const Tile &tile);
+
+	void clear();
+
+	inline const Stats &stats() const {
+		return mStats;
+	}
+
+};
@@ -0,0 +1,43 @@
+#include "VideoWriter.h"
+
+VideoWriter::VideoWriter(std::FILE *file, Format format, int width, int height, int fps)
+	: mFile(file),
+	mFormat(format),
+	mWidth(width),
+	mHeight(height)
+{
+	if (mFormat == Format::Y4M) {
+		// Progressive, square pixels, full chroma resolution:
+		std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height)
+			+ " F" + std::to_string(fps) + ":1 Ip A1:1 C444\n";
+		mBytes += std::fwrite(header.data(), 1, header.size(), mFile);
+		mPlanes.resize(static_cast<size_t>(width) * height * 3);
+	}
+}
+
+void VideoWriter::write(const Rgb *colors)
+{
+	const size_t pixels = static_cast<size_t>(mWidth) * mHeight;
+
+	if (mFormat == Format::RAW) {
+		mBytes += std::fwrite(colors, 1, pixels * sizeof(Rgb), mFile);
+		return;
+	}
+
+	// BT.601 in limited range, in the integer form of the standard:
+	unsigned char *y = mPlanes.data();
+	unsigned char *u = y + pixels;
+	unsigned char *v = u + pixels;
+	for (size_t p = 0; p < pixels; p++) {
+		const int r = colors[p].r;
+		const int g = colors[p].g;
+		const int b = colors[p].b;
+		y[p] = static_cast<unsigned char>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		u[p] = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+		v[p] = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+	}
+
+	static const char FRAME[] = "FRAME\n";
+	mBytes += std::fwrite(FRAME, 1, sizeof(FRAME) - 1, mFile);
+	mBytes += std::fwrite(mPlanes.data(), 1, mPlanes.size(), mFile);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Palette.h"
+
+/**
+ * Streams RGB frames to a file or pipe, one frame at a time, so a video
+ * of any length never needs more than one frame in memory.
+ *
+ * RAW writes the RGB24 pixels back to back, for e.g.
+ * `ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -r 30 -i - zoom.mp4`, which
+ * has to be told the frame size. Y4M writes a YUV4MPEG2 stream, which
+ * carries its own size and rate: a header, then planar 4:4:4 BT.601
+ * frames that encoders and players read directly.
+ */
+class VideoWriter
+{
+
+public:
+
+	enum class Format
+	{
+		RAW,
+		Y4M,
+	};
+
+private:
+
+	std::FILE *mFile;
+	Format mFormat;
+	int mWidth;
+	int mHeight;
+
+	// Y, U and V planes of a frame:
+	std::vector<unsigned char> mPlanes;
+	size_t mBytes = 0;
+
+public:
+
+	/**
+	 * Prepares a stream of `width` x `height` frames at `fps` frames per
+	 * second into `file`, which the writer does not close.
+	 */
+	VideoWriter(std::FILE *file, Format format, int width, int height, int fps);
+
+	/**
+	 * Appends a frame of width * height colors, row by row from the top.
+	 */
+	void write(const Rgb *colors);
+
+	/**
+	 * Bytes written so far, headers included.
+	 */
+	inline size_t bytes() const {
+		return mBytes;
+	}
+
+};
@@ -1,76 +1,782 @@
 #include <iostream>
-#include <complex>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <memory>
+#include <thread>
 #include "Display.h"
+#include "Renderer.h"
+#include "IterationController.h"
+#include "FrameScheduler.h"
+#include "FramePipeline.h"
+#include "GraphicsPresenter.h"
+#include "Keyboard.h"
+#include "LogPolar.h"
+#include "TileCache.h"
+#include "DiskCache.h"
+#include "KeyframeZoom.h"
+#include "VideoWriter.h"
 
-using C = std::complex<double>;
+/**
+ * How frames are rendered and shown, from the command line.
+ */
+struct Options
+{
+	bool progressive = false;
+	// Time limit of a frame in milliseconds, rendered in the background if set:
+	int deadline = 0;
+	bool adaptive = false;
+};
+
+/**
+ * Makes the display render `request` with its iteration cap.
+ */
+static void use_request(Display &d, const RenderRequest &request) {
+	d.setMaxIterations(request.params.maxIterations);
+	d.setKernel(Renderer::kernel(request));
+	d.setFingerprint(TileCache::fingerprint(request));
+}
 
-static int N = 1;
-static C JULIA_C = C{ 0.4, -0.325 };
+/**
+ * Chooses the iteration cap of `request` for the next frame from a sparse
+ * pre-pass over every 4th pixel in both directions, repeating the pre-pass
+ * while the cap keeps rising.
+ */
+static IterationDecision adapt_iterations(const Display &d, RenderRequest &request, const IterationController &controller) {
+	const int STEP = 4;
+	const Dimension &size = d.viewportSize();
+
+	std::vector<double> x, y;
+	for (int py = STEP / 2; py < size.height; py += STEP) {
+		for (int px = STEP / 2; px < size.width; px += STEP) {
+			x.push_back(d.shaderX(px));
+			y.push_back(d.shaderY(py));
+		}
+	}
+	std::vector<int> iterations(x.size());
+	GBufferSpan span;
+	span.iterations = iterations.data();
+
+	IterationDecision decision;
+	for (int round = 0; round < 4; round++) {
+		int current = request.params.maxIterations;
+		Renderer::kernel(request)(x.data(), y.data(), static_cast<int>(x.size()), span);
+		decision = controller.decide(current, iterations.data(), static_cast<int>(iterations.size()));
+		request.params.maxIterations = decision.maxIterations;
+		if (decision.maxIterations <= current) {
+			break;
+		}
+	}
+	return decision;
+}
 
-static char mandelbrot(double x, double y) {
-	C c;
-	c.real(x);
-	c.imag(y);
+/**
+ * Draws a frame, presenting every progressive pass as soon as it is done.
+ */
+static void draw(Display &d, ThreadPool &pool, const Options &options) {
+	if (options.deadline > 0) {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.deadline);
+		std::unique_ptr<RenderJob> job = d.renderAsync(pool, deadline);
+		RenderStatus status = job->wait();
+		d.apply(*job);
+		if (status == RenderStatus::COMPLETE) {
+			d.storeCached({});
+		}
+		d.colorize();
+		d.present();
+		if (status != RenderStatus::COMPLETE) {
+			std::cout << "deadline: " << job->tilesDone() << " of " << job->tileCount() << " tiles rendered" << std::endl;
+		}
+		return;
+	}
+	if (!options.progressive) {
+		d.draw();
+		return;
+	}
+	d.renderProgressive([&d](int) {
+		d.colorize();
+		d.present();
+	});
+}
 
-	C z = c;
-	for (int n = 0; n < N; n++) {
-		z = z * z + c;
-		if (abs(z) > 2) {
-			return ' ';
+/**
+ * Renders `frames` frames without printing them and reports the throughput.
+ * Run under `perf stat -e cycles,instructions` to compare the IPC of builds
+ * with different ESCAPE_INTERLEAVE values, or pass --isa to compare the
+ * kernel variants.
+ */
+static void benchmark(Display &d, const RenderRequest &request, const Options &options, int frames) {
+	const Dimension &size = d.viewportSize();
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; i++) {
+		if (options.progressive) {
+			d.renderProgressive([](int) {});
 		}
+		else {
+			d.render();
+		}
+	}
+	std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+	double pixels = static_cast<double>(size.width) * size.height * frames;
+	std::cout << frames << " frames, " << (request.program ? request.program->source().c_str() : formulaName(request.formula))
+		<< ", N = " << request.params.maxIterations << ", " << request.kernels->name << " kernels: "
+		<< seconds.count() * 1000 / frames << " ms/frame, "
+		<< pixels / seconds.count() / 1e6 << " Mpixel/s" << std::endl;
+
+	if (options.progressive) {
+		const Display::ProgressiveStats &progressive = d.progressiveStats();
+		std::cout << "progressive: " << progressive.computed << " pixels computed, " << progressive.guessed << " guessed" << std::endl;
 	}
 
-	return '+';
+	const Supersampler::Stats &stats = d.supersampler().stats();
+	if (stats.edgePixels > 0) {
+		std::cout << "antialiasing: " << stats.edgePixels << " edge pixels, "
+			<< static_cast<double>(stats.samples) / stats.edgePixels << " extra samples each" << std::endl;
+	}
 }
 
-static char mandelbrot_emulating_complex_numbers(double x, double y) {
-    glm::vec2 c{x, y};
-    glm::vec2 z{c};
+/**
+ * Zooms into the center at `fps` frames per second until double precision
+ * runs out, rendering what fits into each frame's time budget.
+ */
+static void animate(Display &d, ThreadPool &pool, RenderRequest &request, const Options &options, double fps) {
+	const double ZOOM_PER_SECOND = 2;
+	const double MAX_ZOOM = 1e12;
 
-    auto mul = [](const glm::vec2 &a, const glm::vec2 &b) {
-        double real = (a.x * b.x) - (a.y * b.y);
-        double imag = (a.x * b.y) + (a.y * b.x);
-        return glm::vec2{real, imag};
-    };
+	// Frames are drawn in place, sending only what changed:
+	TerminalPresenter presenter;
+	d.setPresenter(&presenter);
 
-    auto length = [](const glm::vec2 &v) {
-        return std::sqrt(v.x * v.x + v.y * v.y);
-    };
+	FrameScheduler scheduler(fps);
+	IterationController controller;
+	for (int frame = 0; d.zoom() < MAX_ZOOM; frame++) {
+		if (options.adaptive) {
+			adapt_iterations(d, request, controller);
+		}
+		use_request(d, request);
+		FrameScheduler::FrameStats stats = scheduler.frame(d, pool, [&d]() {
+			d.present();
+		});
+		std::cout << "frame " << frame << ", zoom " << d.zoom() << ", N = " << request.params.maxIterations << ", "
+			<< stats.tilesRendered << "/" << stats.tileCount << " tiles in " << stats.renderMilliseconds << " ms, oldest "
+			<< stats.maxAge << " frames, " << presenter.lastFrameBytes() << " bytes\x1b[K" << std::endl;
+		d.setZoom(d.zoom() * std::pow(ZOOM_PER_SECOND, 1 / fps));
+	}
+}
+
+/**
+ * Writes `frames` frames zooming into the center through a FramePipeline,
+ * so the output of one frame overlaps the computation of the next.
+ */
+static void pipeline(Display &d, ThreadPool &pool, RenderRequest request, int frames, DiskCache *cache) {
+	const double ZOOM_PER_FRAME = 1.25;
 
-    for(int n = 0; n < N; n++) {
-        z = mul(z, z) + c;
-        if(length(z) > 2) {
-            return ' ';
-        }
-    }
+	request.width = d.viewportSize().width;
+	request.height = d.viewportSize().height;
+	request.center = d.center();
+	request.zoom = d.zoom();
+
+	auto start = std::chrono::steady_clock::now();
+	FramePipeline::Stats stats;
+	{
+		FramePipeline pipeline(pool, d.palette(), stdout, cache);
+		for (int frame = 0; frame < frames; frame++) {
+			pipeline.submit(request);
+			request.zoom *= ZOOM_PER_FRAME;
+		}
+		stats = pipeline.stats();
+	}
+	std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
 
-    return '+';
+	std::cerr << frames << " frames in " << seconds.count() * 1000 << " ms: " << stats.computeSeconds * 1000 << " ms computing, "
+		<< stats.stallSeconds * 1000 << " ms waiting for output" << std::endl;
 }
 
-static char julia(double x, double y) {
+/**
+ * Explores the set interactively: the arrow keys or hjkl pan by an eighth
+ * of the view, + and - zoom, ] and [ raise and lower the iteration cap, r
+ * redraws the screen and q quits.
+ *
+ * Keys are read on their own thread, and each one redirects the render in
+ * flight, keeping its finished tiles. A pan shifts the frame and renders
+ * only the exposed strips, and a cap change only the tiles it affects.
+ * Zooms are by octaves, so the quarter of the pixels sampled before is
+ * kept and the rest is rendered from the center out. Finished tiles are
+ * shown while the rest are still being rendered. With a tile cache, every
+ * render takes what earlier views computed of the same samples, so going
+ * back to a place or a cap seen before costs little.
+ */
+static void explore(Display &d, ThreadPool &pool, RenderRequest &request, const TileCache *cache) {
+	const auto REFRESH = std::chrono::milliseconds(30);
+	const auto NO_DEADLINE = std::chrono::steady_clock::time_point::max();
+	const int width = d.viewportSize().width;
+	const int height = d.viewportSize().height;
+	const std::vector<RenderJob::Tile> all = RenderJob::tiles(width, height, true);
+
+	TerminalPresenter presenter;
+	d.setPresenter(&presenter);
+	auto show = [&](const RenderJob *job) {
+		d.colorize();
+		if (d.output() != Display::Output::CHARACTERS) {
+			std::cout << "\x1b[H";
+		}
+		d.present();
+		std::cout << "\rcenter (" << d.center().x << ", " << d.center().y << "), zoom " << d.zoom()
+			<< ", N = " << request.params.maxIterations;
+		if (job) {
+			std::cout << ", " << job->tilesDone() << "/" << job->tileCount() << " tiles";
+		}
+		if (cache) {
+			const TileCache::Stats &stats = cache->stats();
+			std::cout << ", cache " << stats.hits << "/" << stats.hits + stats.misses << " hits, " << stats.bytes / 1024 << " KiB";
+		}
+		std::cout << "\x1b[K" << std::flush;
+	};
+
+	// Hide the cursor while exploring:
+	std::cout << "\x1b[?25l\x1b[H\x1b[2J";
+	Keyboard keyboard;
+
+	use_request(d, request);
+	std::unique_ptr<RenderJob> job = d.renderAsync(pool, NO_DEADLINE, all);
+	int shown = 0;
+
+	// Regions of the view which still have to be rendered, and pixels in them kept from before a zoom:
+	std::vector<RenderJob::Tile> stale;
+	std::vector<std::uint8_t> kept;
+
+	// Stops the render in flight, keeping its finished tiles:
+	auto stop = [&]() {
+		if (!job) {
+			return;
+		}
+		job->cancel();
+		job->wait();
+		d.apply(*job);
+		for (int t = 0; t < job->tileCount(); t++) {
+			if (!job->tileDone(t)) {
+				stale.push_back(job->tileList()[t]);
+			}
+		}
+		d.storeCached(stale);
+		job.reset();
+	};
+
+	for (bool running = true; running; std::this_thread::sleep_for(REFRESH)) {
+		const int previousCap = request.params.maxIterations;
+		bool changed = false;
+		bool redraw = false;
+
+		KeyEvent event;
+		while (keyboard.poll(event)) {
+			// Pans are whole pixels, so everything still in view is kept:
+			const int panX = std::max(1, width / 8);
+			const int panY = std::max(1, height / 8);
+			char c = event.key == Key::CHARACTER ? event.character : 0;
+			int dx = 0;
+			int dy = 0;
+
+			if (event.key == Key::LEFT || c == 'h') {
+				dx = -panX;
+			}
+			else if (event.key == Key::RIGHT || c == 'l') {
+				dx = panX;
+			}
+			else if (event.key == Key::UP || c == 'k') {
+				dy = -panY;
+			}
+			else if (event.key == Key::DOWN || c == 'j') {
+				dy = panY;
+			}
+			else if (c == '+' || c == '=' || c == '-') {
+				stop();
+				kept = d.zoomOctave(c != '-', stale);
+				stale.assign(1, { 0, 0, width, height });
+				changed = true;
+			}
+			else if (c == ']') {
+				stop();
+				request.params.maxIterations += std::max(1, request.params.maxIterations / 4);
+				changed = true;
+			}
+			else if (c == '[') {
+				stop();
+				request.params.maxIterations = std::max(1, request.params.maxIterations * 4 / 5);
+				changed = true;
+			}
+			else if (c == 'r') {
+				presenter.invalidate();
+				redraw = true;
+			}
+			else if (c == 'q' || c == 3 || event.key == Key::ESCAPE) {
+				running = false;
+			}
+
+			if (dx != 0 || dy != 0) {
+				stop();
+				// Regions still to render move with the view, and the exposed strips join them:
+				for (RenderJob::Tile &region : stale) {
+					region.x -= dx;
+					region.y -= dy;
+				}
+				std::vector<RenderJob::Tile> exposed = d.pan(dx, dy);
+				stale.insert(stale.end(), exposed.begin(), exposed.end());
+				if (!kept.empty()) {
+					std::vector<std::uint8_t> shifted(kept.size(), 0);
+					for (int y = std::max(0, -dy); y < std::min(height, height - dy); y++) {
+						for (int x = std::max(0, -dx); x < std::min(width, width - dx); x++) {
+							shifted[static_cast<size_t>(y) * width + x] = kept[static_cast<size_t>(y + dy) * width + x + dx];
+						}
+					}
+					kept.swap(shifted);
+				}
+				changed = true;
+			}
+		}
+		if (!running) {
+			break;
+		}
+
+		const int cap = request.params.maxIterations;
+		if (changed) {
+			if (cap != previousCap) {
+				// No pixel below both caps changes:
+				std::vector<RenderJob::Tile> reaching = d.tilesReaching(all, std::min(cap, previousCap));
+				stale.insert(stale.end(), reaching.begin(), reaching.end());
+				for (int y = 0; y < height && !kept.empty(); y++) {
+					for (int x = 0; x < width; x++) {
+						if (d.gbuffer().iterations[d.storedIndex(x, y)] >= std::min(cap, previousCap)) {
+							kept[static_cast<size_t>(y) * width + x] = 0;
+						}
+					}
+				}
+			}
+			std::vector<RenderJob::Tile> tiles = RenderJob::tiles(width, height, true, stale);
+			stale.clear();
 
-	C z{ x, y };
-	for (int n = 0; n < N; n++) {
-		z = z * z + JULIA_C;
-		if (abs(z) > 2) {
-			return ' ';
+			use_request(d, request);
+			if (!tiles.empty()) {
+				job = d.renderAsync(pool, NO_DEADLINE, tiles, kept);
+			}
+			shown = 0;
+			redraw = true;
 		}
+
+		if (job && job->tilesDone() > shown) {
+			shown = d.apply(*job);
+			redraw = true;
+		}
+		if (redraw) {
+			show(job.get());
+		}
+		if (job && job->ready()) {
+			d.apply(*job);
+			d.storeCached({});
+			show(job.get());
+			job.reset();
+			kept.clear();
+		}
+	}
+
+	job.reset();
+	d.setPresenter(nullptr);
+	std::cout << "\x1b[?25h" << std::endl;
+}
+
+/**
+ * Writes a zoom of `frames` frames into the center to stdout as a stream of
+ * binary PPM images, e.g. for `ffmpeg -f image2pipe -i - zoom.mp4`. All
+ * frames are reprojected from one log-polar strip.
+ */
+static void log_polar(Display &d, ThreadPool &pool, RenderRequest request, int frames) {
+	// Doubles the zoom every 30 frames:
+	const double ZOOM_PER_FRAME = std::pow(2.0, 1.0 / 30);
+
+	request.width = d.viewportSize().width;
+	request.height = d.viewportSize().height;
+	request.center = d.center();
+	request.zoom = d.zoom();
+
+	auto start = std::chrono::steady_clock::now();
+	LogPolarZoom zoom(request, request.zoom * std::pow(ZOOM_PER_FRAME, frames - 1));
+	zoom.render(pool);
+	std::chrono::duration<double> rendered = std::chrono::steady_clock::now() - start;
+
+	const size_t pixels = static_cast<size_t>(request.width) * request.height;
+	std::vector<int> iterations(pixels);
+	std::vector<Rgb> colors(pixels);
+	Palette &palette = d.palette();
+	palette.build(request.params.maxIterations);
+	std::string header = "P6\n" + std::to_string(request.width) + " " + std::to_string(request.height) + "\n255\n";
+
+	std::chrono::duration<double> reprojected{ 0 };
+	for (int frame = 0; frame < frames; frame++) {
+		auto frameStart = std::chrono::steady_clock::now();
+		zoom.frame(request.zoom * std::pow(ZOOM_PER_FRAME, frame), iterations.data());
+		reprojected += std::chrono::steady_clock::now() - frameStart;
+
+		palette.colorize(iterations.data(), static_cast<int>(pixels), colors.data());
+		std::fwrite(header.data(), 1, header.size(), stdout);
+		std::fwrite(colors.data(), sizeof(Rgb), pixels, stdout);
+	}
+	std::fflush(stdout);
+
+	double samples = static_cast<double>(zoom.angles()) * zoom.radii();
+	std::cerr << frames << " frames from a " << zoom.angles() << "x" << zoom.radii() << " strip, "
+		<< samples / (static_cast<double>(pixels) * frames) * 100 << "% of the samples of rendering every frame: "
+		<< rendered.count() * 1000 << " ms rendering, " << reprojected.count() * 1000 / frames << " ms reprojecting per frame" << std::endl;
+}
+
+/**
+ * Writes a zoom of `frames` frames towards `target` with `writer`, scaled
+ * and cross-faded from one keyframe per octave of zoom.
+ */
+static void video(Display &d, ThreadPool &pool, RenderRequest request, glm::dvec2 target, int frames, VideoWriter &writer, DiskCache *cache) {
+	// Doubles the zoom every 30 frames, one second of video:
+	const int FRAMES_PER_OCTAVE = 30;
+
+	request.width = d.viewportSize().width;
+	request.height = d.viewportSize().height;
+	request.center = d.center();
+	request.zoom = d.zoom();
+
+	KeyframeZoom zoom(pool, request, target, FRAMES_PER_OCTAVE, cache);
+	std::vector<Rgb> colors(static_cast<size_t>(request.width) * request.height);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++) {
+		zoom.frame(frame, d.palette(), colors.data());
+		writer.write(colors.data());
 	}
+	std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+
+	const KeyframeZoom::Stats &stats = zoom.stats();
+	std::cerr << frames << " frames from " << stats.keyframes << " keyframes: "
+		<< stats.renderSeconds * 1000 << " ms rendering, "
+		<< (total.count() - stats.renderSeconds) * 1000 / frames << " ms per frame scaling and writing, "
+		<< writer.bytes() << " bytes" << std::endl;
+}
+
+/**
+ * Prints what the disk cache saved this process, if there is one.
+ */
+static void report_disk_cache(const DiskCache *cache) {
+	if (cache) {
+		DiskCache::Stats stats = cache->stats();
+		std::cerr << "disk cache: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.stores << " stores" << std::endl;
+	}
+}
+
+/**
+ * Renders one image at full resolution and streams it with a terminal
+ * graphics protocol while it is rendered.
+ */
+static void show_image(Display &d, ThreadPool &pool, RenderRequest request, GraphicsPresenter::Protocol protocol) {
+	request.width = d.viewportSize().width;
+	request.height = d.viewportSize().height;
+	request.center = d.center();
+	request.zoom = d.zoom();
+
+	Renderer renderer(pool);
+	GraphicsPresenter presenter(protocol);
+	presenter.present(renderer, request, d.palette());
 
-	return '+';
+	const GraphicsPresenter::Stats &stats = presenter.stats();
+	std::cerr << request.width << "x" << request.height << " in " << stats.frameSeconds * 1000 << " ms, "
+		<< stats.encodeSeconds * 1000 << " ms encoding, " << stats.bytes << " bytes" << std::endl;
 }
 
-int main()
+int main(int argc, char **argv)
 {
+	int width = 100;
+	int height = 50;
+	int benchFrames = 0;
+	int pipelineFrames = 0;
+	int logPolarFrames = 0;
+	int videoFrames = 0;
+	VideoWriter::Format videoFormat = VideoWriter::Format::Y4M;
+	const char *videoPath = nullptr;
+	bool targetGiven = false;
+	glm::dvec2 target{ 0, 0 };
+	Options options;
+	bool histogram = false;
+	bool antialias = false;
+	Display::Output output = Display::Output::CHARACTERS;
+	bool graphics = false;
+	bool interactive = false;
+	bool sizeGiven = false;
+	// Budget of the tile cache in MiB, none if 0:
+	int cacheMiB = 64;
+	// File and size in MiB of the disk cache, none if empty:
+	std::string diskCachePath;
+	int diskCacheMiB = 0;
+	GraphicsPresenter::Protocol protocol = GraphicsPresenter::Protocol::SIXEL;
+	bool centerOut = false;
+	bool differential = false;
+	double fps = 0;
+	std::string ramp = " ";
+	glm::dvec2 center{ 0, 0 };
+	double zoom = 1;
+
+	RenderRequest request;
+	request.kernels = &kernels::best();
+	request.params.juliaX = 0.4;
+	request.params.juliaY = -0.325;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+			benchFrames = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+			request.params.maxIterations = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--isa") == 0 && i + 1 < argc) {
+			Isa isa;
+			if (!kernels::parseIsa(argv[++i], isa)) {
+				std::cerr << "Unknown instruction set " << argv[i] << ", expected baseline, avx2 or avx512" << std::endl;
+				return 1;
+			}
+			if (!kernels::supported(isa)) {
+				std::cerr << "This CPU does not support " << argv[i] << ", falling back to the best supported kernels" << std::endl;
+			}
+			request.kernels = &kernels::select(isa);
+		}
+		else if (std::strcmp(argv[i], "--formula") == 0 && i + 1 < argc) {
+			if (!parseFormula(argv[++i], request.formula)) {
+				std::cerr << "Unknown formula " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--expr") == 0 && i + 1 < argc) {
+			std::string error;
+			std::shared_ptr<FormulaProgram> program = std::make_shared<FormulaProgram>();
+			if (!program->compile(argv[++i], error)) {
+				std::cerr << "Invalid formula: " << error << std::endl;
+				return 1;
+			}
+			request.program = program;
+		}
+		else if (std::strcmp(argv[i], "--julia") == 0) {
+			request.params.julia = true;
+		}
+		else if (std::strcmp(argv[i], "--ramp") == 0 && i + 1 < argc) {
+			ramp = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--histogram") == 0) {
+			histogram = true;
+		}
+		else if (std::strcmp(argv[i], "--aa") == 0) {
+			antialias = true;
+		}
+		else if (std::strcmp(argv[i], "--half-blocks") == 0) {
+			output = Display::Output::HALF_BLOCKS;
+		}
+		else if (std::strcmp(argv[i], "--braille") == 0) {
+			output = Display::Output::BRAILLE;
+		}
+		else if (std::strcmp(argv[i], "--explore") == 0) {
+			interactive = true;
+		}
+		else if (std::strcmp(argv[i], "--sixel") == 0) {
+			graphics = true;
+			protocol = GraphicsPresenter::Protocol::SIXEL;
+		}
+		else if (std::strcmp(argv[i], "--kitty") == 0) {
+			graphics = true;
+			protocol = GraphicsPresenter::Protocol::KITTY;
+		}
+		else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+			cacheMiB = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--disk-cache") == 0 && i + 2 < argc) {
+			diskCachePath = argv[i + 1];
+			diskCacheMiB = std::atoi(argv[i + 2]);
+			i += 2;
+		}
+		else if (std::strcmp(argv[i], "--deadline") == 0 && i + 1 < argc) {
+			options.deadline = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+			pipelineFrames = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--log-polar") == 0 && i + 1 < argc) {
+			logPolarFrames = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--video") == 0 && i + 1 < argc) {
+			videoFrames = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--raw") == 0) {
+			videoFormat = VideoWriter::Format::RAW;
+		}
+		else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+			videoPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--target") == 0 && i + 2 < argc) {
+			target = { std::atof(argv[i + 1]), std::atof(argv[i + 2]) };
+			targetGiven = true;
+			i += 2;
+		}
+		else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+			fps = std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--diff") == 0) {
+			differential = true;
+		}
+		else if (std::strcmp(argv[i], "--progressive") == 0) {
+			options.progressive = true;
+		}
+		else if (std::strcmp(argv[i], "--center-out") == 0) {
+			centerOut = true;
+		}
+		else if (std::strcmp(argv[i], "--adaptive") == 0) {
+			options.adaptive = true;
+		}
+		else if (std::strcmp(argv[i], "--center") == 0 && i + 2 < argc) {
+			center = { std::atof(argv[i + 1]), std::atof(argv[i + 2]) };
+			i += 2;
+		}
+		else if (std::strcmp(argv[i], "--zoom") == 0 && i + 1 < argc) {
+			zoom = std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--size") == 0 && i + 2 < argc) {
+			width = std::atoi(argv[i + 1]);
+			height = std::atoi(argv[i + 2]);
+			sizeGiven = true;
+			i += 2;
+		}
+	}
+
+	// Images are sized in pixels rather than characters:
+	if ((graphics || logPolarFrames > 0 || videoFrames > 0) && !sizeGiven) {
+		width = 800;
+		height = 600;
+	}
+
+	Dimension size{ width, height };
+
+	ThreadPool pool;
+
+	std::unique_ptr<DiskCache> diskCache;
+	if (!diskCachePath.empty()) {
+		std::string error;
+		diskCache.reset(new DiskCache());
+		if (!diskCache->open(diskCachePath, static_cast<size_t>(diskCacheMiB) << 20, error)) {
+			std::cerr << "Cannot use the disk cache: " << error << std::endl;
+			return 1;
+		}
+	}
+
 	Display d;
-	d.setViewportSize({ 100, 50 });
+	if (histogram) {
+		d.setColoring(Display::Coloring::HISTOGRAM, &pool);
+		if (ramp == " ") {
+			ramp = " .:-=*#%@";
+		}
+	}
+	d.setOutput(output);
+	d.setViewportSize(size);
 	d.setViewportOrigin(Display::Origin::CENTER);
-	d.setShader(&mandelbrot_emulating_complex_numbers);
+	d.setCenter(center);
+	d.setZoom(zoom);
+	d.setAntialiasing(antialias);
+	d.setCenterOut(centerOut);
+	use_request(d, request);
+	d.palette().setRamp(ramp, '+');
 
-	while (true) {
-		d.draw();
-		N++;
-		std::cin.ignore();
+	TerminalPresenter presenter;
+	if (differential) {
+		d.setPresenter(&presenter);
 	}
 
+	if (benchFrames > 0) {
+		benchmark(d, request, options, benchFrames);
+		return 0;
+	}
+
+	if (pipelineFrames > 0) {
+		pipeline(d, pool, request, pipelineFrames, diskCache.get());
+		report_disk_cache(diskCache.get());
+		return 0;
+	}
+
+	if (logPolarFrames > 0) {
+		log_polar(d, pool, request, logPolarFrames);
+		return 0;
+	}
+
+	if (videoFrames > 0) {
+		std::FILE *file = videoPath ? std::fopen(videoPath, "wb") : stdout;
+		if (!file) {
+			std::cerr << "Cannot open " << videoPath << std::endl;
+			return 1;
+		}
+		VideoWriter writer(file, videoFormat, d.viewportSize().width, d.viewportSize().height, 30);
+		video(d, pool, request, targetGiven ? target : center, videoFrames, writer, diskCache.get());
+		report_disk_cache(diskCache.get());
+		if (videoPath) {
+			std::fclose(file);
+		}
+		else {
+			std::fflush(file);
+		}
+		return 0;
+	}
+
+	// Only for views revisited by hand, the batch modes never look back:
+	std::unique_ptr<TileCache> cache;
+	if (cacheMiB > 0) {
+		cache.reset(new TileCache(static_cast<size_t>(cacheMiB) << 20));
+	}
+
+	if (interactive) {
+		d.setTileCache(cache.get());
+		explore(d, pool, request, cache.get());
+		return 0;
+	}
+
+	if (graphics) {
+		show_image(d, pool, request, protocol);
+		return 0;
+	}
+
+	if (fps > 0) {
+		animate(d, pool, request, options, fps);
+		return 0;
+	}
+
+	d.setTileCache(cache.get());
+
+	// Ramps cycled by entering "p", which only recolors the last render:
+	const std::string RAMPS[] = { ramp, " .:-=*#%@", " .oO0" };
+	int rampIndex = 0;
+
+	// With adaptive iterations, every frame zooms in instead of raising N by hand:
+	IterationController controller;
+
+	std::string line;
+	do {
+		if (line == "p") {
+			rampIndex = (rampIndex + 1) % 3;
+			d.palette().setRamp(RAMPS[rampIndex], '+');
+			d.colorize();
+			d.present();
+		}
+		else if (options.adaptive) {
+			IterationDecision decision = adapt_iterations(d, request, controller);
+			use_request(d, request);
+			draw(d, pool, options);
+			std::cout << "zoom " << d.zoom() << ", N = " << request.params.maxIterations << ", " << decision.liveFraction * 100 << "% live ("
+				<< decision.reason << ")" << std::endl;
+			d.setZoom(d.zoom() * 2);
+		}
+		else {
+			use_request(d, request);
+			draw(d, pool, options);
+			request.params.maxIterations++;
+		}
+	} while (std::getline(std::cin, line));
+
 }
@@ -505,12 +505,28 @@ void Application::updateUniformBuffer(const std::chrono::milliseconds &passedMil
 
     ubo.fractalTransform.x = aspect * 2.0f / mCurrentZoom;
     ubo.fractalTransform.y = 1 * 2.0f / mCurrentZoom;
-    ubo.fractalTransform[2] = mTranslation.x;
-    ubo.fractalTransform[3] = mTranslation.y;
+
+    // While panning, the view snaps to the pixel grid, so consecutive frames
+    // differ by whole pixels only and fractional pans do not shimmer.
+    // The exact translation is shown once the motion stops:
+    glm::vec2 translation = mTranslation;
+    if (mMoveDirections != glm::vec4(0) && mZoomDirection == 0) {
+        float pixel = 2.0f * ubo.fractalTransform.y / mSwapchainParams.extent.height;
+        translation = glm::round(mTranslation / pixel) * pixel;
+    }
+    ubo.fractalTransform[2] = translation.x;
+    ubo.fractalTransform[3] = translation.y;
+    ubo.iterations.x = maxIterations();
 
     mUniformBuffer.write(&ubo);
 }
 
+int Application::maxIterations() const
+{
+    double octaves = std::max(0.0, std::log2(static_cast<double>(mCurrentZoom)));
+    return static_cast<int>(std::min(10000.0, 300 + 150 * octaves));
+}
+
 void Application::run()
 {
     mFPSSync = std::chrono::system_clock::now();
@@ -700,7 +716,7 @@ void Application::onKey(int key, int action)
             if (!pressed) {
                 return;
             }
-            fmt::printf("Current zoom: x %.2g\n", static_cast<double>(mCurrentZoom));
+            fmt::printf("Current zoom: x %.2g, %d iterations\n", static_cast<double>(mCurrentZoom), maxIterations());
             break;
 
         default:
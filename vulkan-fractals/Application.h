@@ -4,6 +4,7 @@
 #include <set>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <thread>
 
 #define GLFW_INCLUDE_VULKAN
@@ -94,6 +95,8 @@ private:
     struct UniformBufferObject
     {
         glm::vec4 fractalTransform;
+        // x: maximum iteration count
+        glm::ivec4 iterations;
     };
 
     void recreateSwapchain();
@@ -126,6 +129,12 @@ private:
 
     void updateUniformBuffer(const std::chrono::milliseconds &passedMillis);
 
+    /**
+     * Iteration cap for the current zoom. Deeper views need more iterations
+     * to resolve the boundary, shallow ones would waste them.
+     */
+    int maxIterations() const;
+
     void syncWithFPS();
 
     static void sOnKey(GLFWwindow *window, int key, int scancode, int action, int mods);
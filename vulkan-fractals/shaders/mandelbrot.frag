@@ -1,7 +1,6 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-const int N = 300;
 const int COLOR_COUNT = 4;
 const vec4 COLORS[COLOR_COUNT] = vec4[](
     vec4(1.0, 1.0, 1.0, 1.0),
@@ -11,6 +10,12 @@ const vec4 COLORS[COLOR_COUNT] = vec4[](
 );
 const int STRETCH = 5;
 
+layout(binding = 0) uniform UniformBufferObject {
+    vec4 fractalTransform;
+    // x: maximum iteration count
+    ivec4 iterations;
+} ubo;
+
 layout(location = 0) in vec2 vPosition;
 
 layout(location = 0) out vec4 outColor;
@@ -26,7 +31,7 @@ void main() {
     int n = 0;
 
     bool withinMandelbrot = true;
-    for(; n < N; n++) {
+    for(; n < ubo.iterations.x; n++) {
         z = multiplyComplex(z, z) + vPosition;
         if(length(z) > 2) {
             withinMandelbrot = false;
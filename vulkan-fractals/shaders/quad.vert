@@ -3,6 +3,7 @@
 
 layout(binding = 0) uniform UniformBufferObject {
     vec4 fractalTransform;
+    ivec4 iterations;
 } ubo;
 
 layout(location = 0) in vec2 inPosition;